@@ -1,3 +1,19 @@
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 typedef double weight_t;
 typedef int vertex;
 
@@ -17,6 +33,23 @@ struct graph {
 
 typedef struct graph graph_t;
 
+/*Représentation compacte (CSR) d’un graphe non orienté : les voisins de x sont
+targets[offsets[x]] ... targets[offsets[x + 1] - 1], et weights[i] est le poids de l’arête
+menant à targets[i]. Chaque arête apparaît donc deux fois, une fois dans chaque sens.
+Si le graphe a été chargé par csr_map, les trois tableaux pointent directement dans la
+projection en mémoire map (de taille map_size) ; sinon map vaut NULL.*/
+
+struct csr_graph {
+    int n;
+    int *offsets;
+    vertex *targets;
+    weight_t *weights;
+    void *map;
+    size_t map_size;
+};
+
+typedef struct csr_graph csr_t;
+
 /*fonction number_of_edges prenant un pointeur vers un graphe et renvoyant son
 nombre total d’arêtes. Attention à ne compter chaque arête qu’une seule fois, le graphe est
 non orienté.*/
@@ -61,14 +94,6 @@ int compare_weights(const void *e1, const void *e2){
     return 0;
 }
 
-/*fonction sort_edges qui prend en entrée un tableau d’arêtes et le trie par poids
-croissant. On pourra utiliser la fonction qsort de la bibliothèque standard (mais il n’est
-pas forcément inutile de ré-écrire votre propre tri rapide, juste pour l’entraînement)*/
-
-void sort_edges(edge *edges, int p){
-    qsort(edges, p, sizeof(edge), compare_weights);
-}
-
 
 
 void swap_edges(edge *arr, int i, int j){
@@ -102,6 +127,86 @@ void quicksort_edges(edge *arr, int len){
     quicksort_edges(arr + pivot + 1, len - pivot - 1);
 }
 
+/*Tri par base (LSD, octet par octet) sur la représentation IEEE-754 des poids. La clé
+weight_key est croissante avec le poids : on inverse tous les bits des négatifs et on
+met à 1 le bit de signe des positifs. Les NaN sont tous envoyés en fin de tableau.*/
+
+_Static_assert(sizeof(weight_t) == sizeof(uint64_t), "weight_t doit être un double");
+
+uint64_t weight_key(weight_t w){
+    if (isnan(w)) return UINT64_MAX;
+    uint64_t bits;
+    memcpy(&bits, &w, sizeof(bits));
+    if (bits >> 63) return ~bits;
+    return bits | (1ULL << 63);
+}
+
+void radix_sort_edges(edge *edges, int p){
+    if (p <= 1) return;
+    int counts[8][256] = {{0}};
+    for (int i = 0; i < p; i++) {
+        uint64_t k = weight_key(edges[i].rho);
+        for (int b = 0; b < 8; b++) {
+            counts[b][(k >> (8 * b)) & 255]++;
+        }
+    }
+    edge *tmp = malloc(p * sizeof(edge));
+    edge *src = edges;
+    edge *dst = tmp;
+    uint64_t first_key = weight_key(edges[0].rho);
+    for (int b = 0; b < 8; b++) {
+        // passe inutile si toutes les clés ont le même octet numéro b
+        if (counts[b][(first_key >> (8 * b)) & 255] == p) continue;
+        int next[256];
+        int sum = 0;
+        for (int d = 0; d < 256; d++) {
+            next[d] = sum;
+            sum += counts[b][d];
+        }
+        for (int i = 0; i < p; i++) {
+            int d = (weight_key(src[i].rho) >> (8 * b)) & 255;
+            dst[next[d]] = src[i];
+            next[d]++;
+        }
+        edge *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != edges) memcpy(edges, src, p * sizeof(edge));
+    free(tmp);
+}
+
+/*Méthode de tri utilisée par sort_edges, modifiable à l’exécution (option -s de main)
+pour comparer les trois tris sur un même graphe.*/
+
+enum sort_method {SORT_QSORT, SORT_QUICKSORT, SORT_RADIX};
+
+typedef enum sort_method sort_method_t;
+
+const char *sort_names[] = {"qsort", "quicksort", "radix"};
+
+#define NB_SORT_METHODS 3
+
+sort_method_t edge_sort = SORT_QSORT;
+
+/*fonction sort_edges qui prend en entrée un tableau d’arêtes et le trie par poids
+croissant. On pourra utiliser la fonction qsort de la bibliothèque standard (mais il n’est
+pas forcément inutile de ré-écrire votre propre tri rapide, juste pour l’entraînement)*/
+
+void sort_edges(edge *edges, int p){
+    switch (edge_sort) {
+    case SORT_QSORT:
+        qsort(edges, p, sizeof(edge), compare_weights);
+        break;
+    case SORT_QUICKSORT:
+        quicksort_edges(edges, p);
+        break;
+    case SORT_RADIX:
+        radix_sort_edges(edges, p);
+        break;
+    }
+}
+
 /*fonction print_edge_array qui affiche le contenu d’un tableau d’arêtes. Utiliser
 cette fonction pour vérifier sur le graphe fourni en exemple le bon fonctionnement des
 get_edges et sort_edges*/
@@ -164,60 +269,195 @@ void merge(partition_t *p, int x, int y){
 }
 
 
+/*Variante itérative de la structure union-find : compression par division de chemin
+(chaque sommet parcouru est rattaché à son grand-parent, en une seule passe) et union par
+rang. Une racine r stocke -1 - rang(r) au lieu de l’opposé de la taille : une partition
+donnée ne doit donc être modifiée qu’avec merge ou qu’avec merge_rank, pas les deux
+(find et find_halving fonctionnent avec les deux conventions).*/
+
+int find_halving(partition_t *p, int x){
+    int *arr = p->arr;
+    while (arr[x] >= 0) {
+        int parent = arr[x];
+        if (arr[parent] < 0) return parent;
+        arr[x] = arr[parent];
+        x = arr[parent];
+    }
+    return x;
+}
+
+/*fonction find_pair qui calcule simultanément les représentants de x et de y, en
+faisant avancer les deux chemins à tour de rôle (ce qui permet de s’arrêter dès qu’ils se
+rejoignent, et laisse le processeur traiter les deux suites d’accès mémoire en parallèle)*/
+
+void find_pair(partition_t *p, int x, int y, int *rx, int *ry){
+    int *arr = p->arr;
+    while (x != y && (arr[x] >= 0 || arr[y] >= 0)) {
+        if (arr[x] >= 0) {
+            int parent = arr[x];
+            if (arr[parent] >= 0) arr[x] = arr[parent];
+            x = arr[x];
+        }
+        if (arr[y] >= 0) {
+            int parent = arr[y];
+            if (arr[parent] >= 0) arr[y] = arr[parent];
+            y = arr[y];
+        }
+    }
+    *rx = x;
+    *ry = y;
+}
+
+/*fonction link_roots qui fusionne les ensembles de représentants distincts rx et ry*/
+
+void link_roots(partition_t *p, int rx, int ry){
+    if (p->arr[rx] < p->arr[ry]) {
+        p->arr[ry] = rx;
+    } else if (p->arr[rx] > p->arr[ry]) {
+        p->arr[rx] = ry;
+    } else {
+        p->arr[ry] = rx;
+        p->arr[rx]--;
+    }
+    p->nb_sets--;
+}
+
+/*fonction merge_rank qui fusionne les ensembles de x et de y et renvoie true s’ils
+étaient distincts*/
+
+bool merge_rank(partition_t *p, int x, int y){
+    int rx, ry;
+    find_pair(p, x, y, &rx, &ry);
+    if (rx == ry) return false;
+    link_roots(p, rx, ry);
+    return true;
+}
+
+/*fonction merge_many qui fusionne successivement les extrémités des len arêtes du
+tableau edges, recopie dans chosen celles qui ont effectivement réuni deux ensembles, et
+renvoie leur nombre. On s’arrête dès qu’il ne reste plus qu’un ensemble.*/
+
+int merge_many(partition_t *p, edge *edges, int len, edge *chosen){
+    int nb_chosen = 0;
+    for (int i = 0; i < len && p->nb_sets > 1; i++) {
+        if (merge_rank(p, edges[i].x, edges[i].y)) {
+            chosen[nb_chosen] = edges[i];
+            nb_chosen++;
+        }
+    }
+    return nb_chosen;
+}
+
+
 /*Entrées g est un pointeur vers un graphe pondéré non orienté, nb_chosen est un argument
 de sortie.
 Sortie Un pointeur vers un bloc alloué d’arêtes qui constituent une forêt couvrante minimale de g.
 Effet secondaire Après l’appel, la valeur pointée par nb_chosen doit être égale au nombre
 d’arêtes choisies.*/
 
+/*fonction kruskal_scan qui parcourt le tableau edges (supposé trié par poids
+croissant) et ajoute à mst, à partir de l’indice next_index, les arêtes qui relient deux
+ensembles distincts de part. Elle renvoie le nouveau nombre d’arêtes de mst.*/
+
+int kruskal_scan(partition_t *part, edge *edges, int p, edge *mst, int next_index){
+    return next_index + merge_many(part, edges, p, mst + next_index);
+}
+
+/*fonction kruskal_edges qui applique l’algorithme de Kruskal au tableau edges des p
+arêtes d’un graphe à n sommets (le tableau est trié sur place)*/
+
+edge *kruskal_edges(int n, edge *edges, int p, int *nb_chosen){
+    sort_edges(edges, p);
+    partition_t *part = partition_new(n);
+    edge *mst = malloc((n - 1) * sizeof(edge));
+    *nb_chosen = kruskal_scan(part, edges, p, mst, 0);
+    partition_free(part);
+    return mst;
+}
+
 edge *kruskal(graph_t *g, int *nb_chosen){
     int p;
     edge *edges = get_edges(g, &p);
-    sort_edges(edges, p);
-    partition_t *part = partition_new(g->n);
-    edge *mst = malloc((g->n - 1) * sizeof(edge));
-    int next_index = 0;
-    for (int i = 0; i < p; i++) {
-        if (nb_sets(part) == 1) break;
-        edge e = edges[i];
-        if (find(part, e.x) == find(part, e.y)) continue;
-        merge(part, e.x, e.y);
-        mst[next_index] = e;
-        next_index++;
-    }
+    edge *mst = kruskal_edges(g->n, edges, p, nb_chosen);
     free(edges);
-    partition_free(part);
-    *nb_chosen = next_index;
     return mst;
 }
 
 
 
-weight_t total_weight(edge *edges, int len){
-    float s = 0.;
-    for (int i = 0; i < len; i++) {
-        s += edges[i].rho;
-    }
-    return s;
-}
+/*Somme des poids avec compensation de Neumaier : c accumule les erreurs d’arrondi
+commises sur s, ce qui rend l’erreur finale indépendante (au premier ordre) du nombre
+d’arêtes. Pour que le résultat ne dépende pas non plus du nombre de threads, le tableau
+est découpé en blocs de SUM_BLOCK arêtes fixés à l’avance : chaque bloc est sommé
+séparément (éventuellement par des threads différents), puis les sommes des blocs sont
+combinées toujours dans le même ordre. Le résultat est donc identique bit à bit quel que
+soit nb_threads (à condition de ne pas compiler avec -ffast-math, qui supprimerait la
+compensation).*/
 
+#define SUM_BLOCK 4096
 
+struct compensated_sum {
+    weight_t s;
+    weight_t c;
+};
 
+void neumaier_add(struct compensated_sum *acc, weight_t x){
+    weight_t t = acc->s + x;
+    if (fabs(acc->s) >= fabs(x)) acc->c += (acc->s - t) + x;
+    else acc->c += (x - t) + acc->s;
+    acc->s = t;
+}
 
-int main(void){
-    graph_t *g = read_graph(stdin);
-    int nb_chosen;
-    edge *edges = kruskal(g, &nb_chosen);
-    bool connected = (nb_chosen == g->n - 1);
-    if (connected) {
-        printf("Minimum Spanning Tree:\n");
-    } else {
-        printf("Minimum Spanning Forest (%d trees):\n", g->n - nb_chosen);
+struct sum_worker {
+    edge *edges;
+    int len;
+    struct compensated_sum *blocks;
+    int first_block;
+    int last_block;
+};
+
+void *sum_blocks(void *arg){
+    struct sum_worker *w = arg;
+    for (int b = w->first_block; b < w->last_block; b++) {
+        struct compensated_sum acc = {0., 0.};
+        int end = (b + 1) * SUM_BLOCK < w->len ? (b + 1) * SUM_BLOCK : w->len;
+        for (int i = b * SUM_BLOCK; i < end; i++) {
+            neumaier_add(&acc, w->edges[i].rho);
+        }
+        w->blocks[b] = acc;
     }
-    printf("Total weight %.3f\n", total_weight(edges, nb_chosen));
-    print_edge_array(edges, nb_chosen);
-    free(edges);
-    graph_free(g);
+    return NULL;
+}
+
+weight_t parallel_total_weight(edge *edges, int len, int nb_threads){
+    int nb_blocks = (len + SUM_BLOCK - 1) / SUM_BLOCK;
+    if (nb_threads > nb_blocks) nb_threads = nb_blocks > 0 ? nb_blocks : 1;
+    struct compensated_sum *blocks = malloc(nb_blocks * sizeof(struct compensated_sum));
+    struct sum_worker *workers = malloc(nb_threads * sizeof(struct sum_worker));
+    pthread_t *threads = malloc(nb_threads * sizeof(pthread_t));
+    for (int t = 0; t < nb_threads; t++) {
+        workers[t].edges = edges;
+        workers[t].len = len;
+        workers[t].blocks = blocks;
+        workers[t].first_block = (long long)nb_blocks * t / nb_threads;
+        workers[t].last_block = (long long)nb_blocks * (t + 1) / nb_threads;
+        if (t > 0) pthread_create(&threads[t], NULL, sum_blocks, &workers[t]);
+    }
+    sum_blocks(&workers[0]);
+    for (int t = 1; t < nb_threads; t++) pthread_join(threads[t], NULL);
+    struct compensated_sum acc = {0., 0.};
+    for (int b = 0; b < nb_blocks; b++) {
+        neumaier_add(&acc, blocks[b].s);
+        acc.c += blocks[b].c;
+    }
+    free(blocks);
+    free(workers);
+    free(threads);
+    return acc.s + acc.c;
+}
+
+weight_t total_weight(edge *edges, int len){
+    return parallel_total_weight(edges, len, 1);
 }
 
 
@@ -249,8 +489,8 @@ int *get_components(graph_t *g, int *nb_components){
     for (int i = 0; i < g->n; i++) arr[i] = -1;
     for (vertex x = 0; x < g->n; x++) {
         if (arr[x] == -1) {
+            explore(g, arr, *nb_components, x);
             (*nb_components)++;
-            explore(g, arr, x, x);
         }
     }
     return arr;
@@ -342,3 +582,2616 @@ graph_t *boruvka(graph_t *g){
     while (!add_edges(g, t)) {}
     return t;
 }
+
+
+
+/*fonction csr_from_edges qui construit la représentation CSR du graphe à n sommets
+dont les p arêtes (non orientées) sont données dans le tableau edges*/
+
+csr_t *csr_from_edges(int n, edge *edges, int p){
+    csr_t *g = malloc(sizeof(csr_t));
+    g->n = n;
+    g->map = NULL;
+    g->offsets = calloc(n + 1, sizeof(int));
+    g->targets = malloc(2 * (size_t)p * sizeof(vertex));
+    g->weights = malloc(2 * (size_t)p * sizeof(weight_t));
+    for (int i = 0; i < p; i++) {
+        g->offsets[edges[i].x + 1]++;
+        g->offsets[edges[i].y + 1]++;
+    }
+    for (vertex x = 0; x < n; x++) {
+        g->offsets[x + 1] += g->offsets[x];
+    }
+    int *next = malloc(n * sizeof(int));
+    memcpy(next, g->offsets, n * sizeof(int));
+    for (int i = 0; i < p; i++) {
+        edge e = edges[i];
+        g->targets[next[e.x]] = e.y;
+        g->weights[next[e.x]] = e.rho;
+        next[e.x]++;
+        g->targets[next[e.y]] = e.x;
+        g->weights[next[e.y]] = e.rho;
+        next[e.y]++;
+    }
+    free(next);
+    return g;
+}
+
+/*fonction csr_from_graph qui renvoie la représentation CSR d’un graph_t (les listes
+d’adjacence sont recopiées dans le même ordre)*/
+
+csr_t *csr_from_graph(graph_t *g){
+    csr_t *c = malloc(sizeof(csr_t));
+    c->n = g->n;
+    c->map = NULL;
+    c->offsets = malloc((g->n + 1) * sizeof(int));
+    c->offsets[0] = 0;
+    for (vertex x = 0; x < g->n; x++) {
+        c->offsets[x + 1] = c->offsets[x] + g->degrees[x];
+    }
+    c->targets = malloc(c->offsets[g->n] * sizeof(vertex));
+    c->weights = malloc(c->offsets[g->n] * sizeof(weight_t));
+    for (vertex x = 0; x < g->n; x++) {
+        for (int i = 0; i < g->degrees[x]; i++) {
+            c->targets[c->offsets[x] + i] = g->adj[x][i].y;
+            c->weights[c->offsets[x] + i] = g->adj[x][i].rho;
+        }
+    }
+    return c;
+}
+
+/*fonction csr_to_graph qui effectue la conversion inverse (le graph_t renvoyé se
+libère avec graph_free)*/
+
+graph_t *csr_to_graph(csr_t *c){
+    graph_t *g = malloc(sizeof(graph_t));
+    g->n = c->n;
+    g->degrees = malloc(g->n * sizeof(int));
+    g->adj = malloc(g->n * sizeof(edge*));
+    for (vertex x = 0; x < g->n; x++) {
+        g->degrees[x] = c->offsets[x + 1] - c->offsets[x];
+        g->adj[x] = malloc(g->degrees[x] * sizeof(edge));
+        for (int i = 0; i < g->degrees[x]; i++) {
+            edge e = {.x = x, .y = c->targets[c->offsets[x] + i], .rho = c->weights[c->offsets[x] + i]};
+            g->adj[x][i] = e;
+        }
+    }
+    return g;
+}
+
+/*fonction csr_read_graph qui lit un graphe au même format que read_graph et le
+renvoie sous forme CSR*/
+
+csr_t *csr_read_graph(FILE *f){
+    graph_t *g = read_graph(f);
+    csr_t *c = csr_from_graph(g);
+    graph_free(g);
+    return c;
+}
+
+void csr_free(csr_t *g){
+    if (g->map != NULL) {
+        munmap(g->map, g->map_size);
+    } else {
+        free(g->offsets);
+        free(g->targets);
+        free(g->weights);
+    }
+    free(g);
+}
+
+/*Format binaire d’un graphe CSR, prévu pour être projeté en mémoire et utilisé sur
+place : un en-tête graph_header, puis offsets (n + 1 entiers), targets (nb_entries
+entiers), des octets nuls jusqu’au prochain multiple de 8, et enfin weights (nb_entries
+poids). Tous les entiers sont stockés dans l’ordre natif de la machine.*/
+
+#define GRAPH_MAGIC 0x4753534d
+
+struct graph_header {
+    uint32_t magic;
+    uint32_t weight_size;
+    int64_t n;
+    int64_t nb_entries;
+};
+
+size_t weights_position(int64_t n, int64_t nb_entries){
+    size_t position = sizeof(struct graph_header) + (n + 1 + nb_entries) * sizeof(int);
+    return (position + 7) / 8 * 8;
+}
+
+/*fonction csr_write qui enregistre g au format binaire dans le fichier path, et
+renvoie false en cas d’erreur. Les boucles, qui n’appartiennent à aucune forêt couvrante,
+ne sont pas enregistrées (csr_map refuse les fichiers qui en contiennent).*/
+
+bool csr_write(csr_t *g, const char *path){
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) return false;
+    int nb_entries = 0;
+    for (vertex x = 0; x < g->n; x++) {
+        for (int i = g->offsets[x]; i < g->offsets[x + 1]; i++) {
+            if (g->targets[i] != x) nb_entries++;
+        }
+    }
+    struct graph_header h = {.magic = GRAPH_MAGIC, .weight_size = sizeof(weight_t),
+                             .n = g->n, .nb_entries = nb_entries};
+    fwrite(&h, sizeof(h), 1, f);
+    int offset = 0;
+    fwrite(&offset, sizeof(int), 1, f);
+    for (vertex x = 0; x < g->n; x++) {
+        for (int i = g->offsets[x]; i < g->offsets[x + 1]; i++) {
+            if (g->targets[i] != x) offset++;
+        }
+        fwrite(&offset, sizeof(int), 1, f);
+    }
+    for (vertex x = 0; x < g->n; x++) {
+        for (int i = g->offsets[x]; i < g->offsets[x + 1]; i++) {
+            if (g->targets[i] != x) fwrite(&g->targets[i], sizeof(vertex), 1, f);
+        }
+    }
+    long padding = weights_position(h.n, h.nb_entries) - ftell(f);
+    for (long i = 0; i < padding; i++) fputc(0, f);
+    for (vertex x = 0; x < g->n; x++) {
+        for (int i = g->offsets[x]; i < g->offsets[x + 1]; i++) {
+            if (g->targets[i] != x) fwrite(&g->weights[i], sizeof(weight_t), 1, f);
+        }
+    }
+    bool ok = !ferror(f);
+    return fclose(f) == 0 && ok;
+}
+
+int compare_endpoints(const void *e1, const void *e2){
+    const edge *e = e1;
+    const edge *f = e2;
+    if (e->x != f->x) return e->x < f->x ? -1 : 1;
+    if (e->y != f->y) return e->y < f->y ? -1 : 1;
+    return compare_weights(e1, e2);
+}
+
+/*fonction csr_symmetric qui vérifie que chaque entrée x → y de poids w a une entrée
+y → x de même poids qui lui correspond (arêtes multiples comprises) : on trie les entrées
+x < y et les entrées x > y retournées, et les deux tableaux doivent coïncider*/
+
+bool csr_symmetric(const int *offsets, const vertex *targets, const weight_t *weights,
+                   int n, int nb_entries){
+    edge *forward = malloc((nb_entries / 2 + 1) * sizeof(edge));
+    edge *backward = malloc((nb_entries / 2 + 1) * sizeof(edge));
+    int nb_forward = 0;
+    int nb_backward = 0;
+    bool ok = true;
+    for (vertex x = 0; x < n && ok; x++) {
+        for (int i = offsets[x]; i < offsets[x + 1] && ok; i++) {
+            vertex y = targets[i];
+            if (x < y && nb_forward < nb_entries / 2) {
+                edge e = {.x = x, .y = y, .rho = weights[i]};
+                forward[nb_forward++] = e;
+            } else if (x > y && nb_backward < nb_entries / 2) {
+                edge e = {.x = y, .y = x, .rho = weights[i]};
+                backward[nb_backward++] = e;
+            } else {
+                ok = false;
+            }
+        }
+    }
+    if (ok) {
+        qsort(forward, nb_forward, sizeof(edge), compare_endpoints);
+        qsort(backward, nb_backward, sizeof(edge), compare_endpoints);
+        for (int i = 0; i < nb_forward && ok; i++) {
+            ok = compare_endpoints(&forward[i], &backward[i]) == 0;
+        }
+    }
+    free(forward);
+    free(backward);
+    return ok;
+}
+
+/*fonction csr_valid qui vérifie qu’un en-tête relu décrit un fichier de taille size, que
+offsets est croissant de 0 à nb_entries, que tous les voisins sont des sommets autres que
+x lui-même, qu’aucun poids n’est NaN, et que chaque arête apparaît dans les deux sens
+avec le même poids (ce que supposent csr_get_edges et les moteurs), pour qu’un fichier
+tronqué ou corrompu ne puisse pas faire sortir les moteurs des tableaux*/
+
+bool csr_valid(const struct graph_header *h, size_t size){
+    if (h->magic != GRAPH_MAGIC || h->weight_size != sizeof(weight_t)) return false;
+    if (h->n < 0 || h->n >= INT_MAX || h->nb_entries < 0 || h->nb_entries > INT_MAX) return false;
+    if (weights_position(h->n, h->nb_entries) + h->nb_entries * sizeof(weight_t) > size) {
+        return false;
+    }
+    const int *offsets = (const int*)(h + 1);
+    const vertex *targets = offsets + h->n + 1;
+    if (offsets[0] != 0 || offsets[h->n] != h->nb_entries) return false;
+    for (int64_t x = 0; x < h->n; x++) {
+        if (offsets[x] > offsets[x + 1]) return false;
+    }
+    for (int64_t x = 0; x < h->n; x++) {
+        for (int i = offsets[x]; i < offsets[x + 1]; i++) {
+            if (targets[i] < 0 || targets[i] >= h->n || targets[i] == x) return false;
+        }
+    }
+    const weight_t *weights = (const weight_t*)((const char*)h + weights_position(h->n, h->nb_entries));
+    for (int64_t i = 0; i < h->nb_entries; i++) {
+        if (isnan(weights[i])) return false;
+    }
+    if (h->nb_entries % 2 != 0) return false;
+    return csr_symmetric(offsets, targets, weights, h->n, h->nb_entries);
+}
+
+/*fonction csr_map qui projette en mémoire un fichier écrit par csr_write et renvoie le
+graphe correspondant, sans recopie (ou NULL si le fichier n’est pas valide)*/
+
+csr_t *csr_map(const char *path){
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(struct graph_header)) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+    struct graph_header *h = map;
+    if (!csr_valid(h, st.st_size)) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    csr_t *g = malloc(sizeof(csr_t));
+    g->n = h->n;
+    g->offsets = (int*)(h + 1);
+    g->targets = g->offsets + g->n + 1;
+    g->weights = (weight_t*)((char*)map + weights_position(h->n, h->nb_entries));
+    g->map = map;
+    g->map_size = st.st_size;
+    return g;
+}
+
+int csr_number_of_edges(csr_t *g){
+    return g->offsets[g->n] / 2;
+}
+
+edge *csr_get_edges(csr_t *g, int *nb_edges){
+    int p = csr_number_of_edges(g);
+    *nb_edges = p;
+    edge *arr = malloc(p * sizeof(edge));
+    int next_index = 0;
+    for (vertex x = 0; x < g->n; x++) {
+        for (int i = g->offsets[x]; i < g->offsets[x + 1]; i++) {
+            if (x < g->targets[i]) {
+                edge e = {.x = x, .y = g->targets[i], .rho = g->weights[i]};
+                arr[next_index] = e;
+                next_index++;
+            }
+        }
+    }
+    *nb_edges = next_index;
+    return arr;
+}
+
+edge *csr_kruskal(csr_t *g, int *nb_chosen){
+    int p;
+    edge *edges = csr_get_edges(g, &p);
+    edge *mst = kruskal_edges(g->n, edges, p, nb_chosen);
+    free(edges);
+    return mst;
+}
+
+/*Même contrat que get_components. Le parcours utilise une pile explicite (de taille
+au plus n) plutôt que la récursion, pour ne pas faire déborder la pile d’appels sur
+les grandes composantes.*/
+
+int *csr_get_components(csr_t *g, int *nb_components){
+    int *arr = malloc(g->n * sizeof(int));
+    vertex *stack = malloc(g->n * sizeof(vertex));
+    *nb_components = 0;
+    for (int i = 0; i < g->n; i++) arr[i] = -1;
+    for (vertex x = 0; x < g->n; x++) {
+        if (arr[x] != -1) continue;
+        int c = *nb_components;
+        int length = 0;
+        arr[x] = c;
+        stack[length++] = x;
+        while (length > 0) {
+            vertex y = stack[--length];
+            for (int i = g->offsets[y]; i < g->offsets[y + 1]; i++) {
+                vertex z = g->targets[i];
+                if (arr[z] == -1) {
+                    arr[z] = c;
+                    stack[length++] = z;
+                }
+            }
+        }
+        (*nb_components)++;
+    }
+    free(stack);
+    return arr;
+}
+
+edge *csr_get_minimal_edges_scalar(csr_t *g, int *components, int nb_components){
+    edge *edges = malloc(nb_components * sizeof(edge));
+    for (int i = 0; i < nb_components; i++) {
+        edge e = {.x = -1, .y = -1, .rho = INFINITY};
+        edges[i] = e;
+    }
+    for (vertex x = 0; x < g->n; x++) {
+        int c = components[x];
+        for (int i = g->offsets[x]; i < g->offsets[x + 1]; i++) {
+            if (components[g->targets[i]] != c && g->weights[i] < edges[c].rho) {
+                edge e = {.x = x, .y = g->targets[i], .rho = g->weights[i]};
+                edges[c] = e;
+            }
+        }
+    }
+    return edges;
+}
+
+/*Version vectorisée (AVX2) de csr_get_minimal_edges_scalar : pour chaque sommet x, on
+traite les arêtes quatre par quatre, en récupérant les composantes des quatre cibles par
+une lecture indirecte groupée (gather), et on remplace par +∞ les poids des arêtes
+internes à la composante de x avant d’en prendre le minimum. Ce n’est que lorsque le
+minimum de la ligne améliore edges[c] que l’on cherche (de façon scalaire) la première
+arête qui le réalise, ce qui donne exactement le même résultat que la version scalaire.*/
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+edge *csr_get_minimal_edges_avx2(csr_t *g, int *components, int nb_components){
+    edge *edges = malloc(nb_components * sizeof(edge));
+    for (int i = 0; i < nb_components; i++) {
+        edge e = {.x = -1, .y = -1, .rho = INFINITY};
+        edges[i] = e;
+    }
+    __m256d infinity = _mm256_set1_pd(INFINITY);
+    for (vertex x = 0; x < g->n; x++) {
+        int c = components[x];
+        int start = g->offsets[x];
+        int end = g->offsets[x + 1];
+        __m128i vc = _mm_set1_epi32(c);
+        __m256d vmin = infinity;
+        int i = start;
+        for (; i + 4 <= end; i += 4) {
+            __m128i targets = _mm_loadu_si128((__m128i*)(g->targets + i));
+            __m128i comp = _mm_i32gather_epi32(components, targets, 4);
+            __m256i same = _mm256_cvtepi32_epi64(_mm_cmpeq_epi32(comp, vc));
+            __m256d w = _mm256_loadu_pd(g->weights + i);
+            w = _mm256_blendv_pd(w, infinity, _mm256_castsi256_pd(same));
+            // dans cet ordre, un poids NaN est ignoré comme dans la version scalaire
+            vmin = _mm256_min_pd(w, vmin);
+        }
+        __m128d m2 = _mm_min_pd(_mm256_castpd256_pd128(vmin), _mm256_extractf128_pd(vmin, 1));
+        m2 = _mm_min_sd(m2, _mm_unpackhi_pd(m2, m2));
+        weight_t m = _mm_cvtsd_f64(m2);
+        for (; i < end; i++) {
+            if (components[g->targets[i]] != c && g->weights[i] < m) m = g->weights[i];
+        }
+        if (m < edges[c].rho) {
+            for (i = start; i < end; i++) {
+                if (components[g->targets[i]] != c && g->weights[i] == m) break;
+            }
+            edge e = {.x = x, .y = g->targets[i], .rho = m};
+            edges[c] = e;
+        }
+    }
+    return edges;
+}
+
+bool has_avx2(void){
+    return __builtin_cpu_supports("avx2");
+}
+#else
+edge *csr_get_minimal_edges_avx2(csr_t *g, int *components, int nb_components){
+    return csr_get_minimal_edges_scalar(g, components, nb_components);
+}
+
+bool has_avx2(void){
+    return false;
+}
+#endif
+
+/*fonction csr_get_minimal_edges, même contrat que get_minimal_edges ; la version
+vectorisée est choisie à l’exécution si le processeur dispose d’AVX2*/
+
+edge *csr_get_minimal_edges(csr_t *g, int *components, int nb_components){
+    if (has_avx2()) return csr_get_minimal_edges_avx2(g, components, nb_components);
+    return csr_get_minimal_edges_scalar(g, components, nb_components);
+}
+
+/*fonction partition_labels qui remplit labels (de taille p->nb_elements) avec le
+numéro de l’ensemble de chaque élément, avec les mêmes conventions que get_components,
+et renvoie le nombre d’ensembles*/
+
+int partition_labels(partition_t *p, int *labels){
+    int k = 0;
+    for (int x = 0; x < p->nb_elements; x++) labels[x] = -1;
+    for (int x = 0; x < p->nb_elements; x++) {
+        int r = find_halving(p, x);
+        if (labels[r] == -1) {
+            labels[r] = k;
+            k++;
+        }
+        labels[x] = labels[r];
+    }
+    return k;
+}
+
+/*fonction csr_boruvka qui calcule une forêt couvrante minimale d’un graphe CSR par
+l’algorithme de Boruvka. Comme un graphe CSR ne peut pas recevoir d’arêtes, la forêt T
+en cours de construction est représentée par une partition de ses sommets plutôt que par
+un graph_t.*/
+
+edge *csr_boruvka(csr_t *g, int *nb_chosen){
+    partition_t *part = partition_new(g->n);
+    edge *mst = malloc((g->n - 1) * sizeof(edge));
+    int *components = malloc(g->n * sizeof(int));
+    int next_index = 0;
+    while (nb_sets(part) > 1) {
+        int nb_components = partition_labels(part, components);
+        edge *edges = csr_get_minimal_edges(g, components, nb_components);
+        int nb_added = 0;
+        for (int i = 0; i < nb_components; i++) {
+            edge e = edges[i];
+            // composante sans arête sortante, ou arête déjà ajoutée depuis
+            // l’autre extrémité
+            if (e.x == -1 || find(part, e.x) == find(part, e.y)) continue;
+            merge(part, e.x, e.y);
+            mst[next_index] = e;
+            next_index++;
+            nb_added++;
+        }
+        free(edges);
+        if (nb_added == 0) break;
+    }
+    free(components);
+    partition_free(part);
+    *nb_chosen = next_index;
+    return mst;
+}
+
+
+
+/*Union-find concurrent sans verrou, utilisable simultanément par plusieurs threads sur
+le tableau d’une partition_t. Les liaisons se font par compare-and-swap sur la case d’une
+racine, toujours de la racine de plus faible priorité vers l’autre (liaison aléatoire à
+la Jayanti–Tarjan, la priorité étant une permutation pseudo-aléatoire des sommets) : les
+priorités croissent strictement le long d’un chemin, ce qui interdit les cycles même
+quand plusieurs liaisons ont lieu en même temps. Les racines valent toujours -1 (ni
+taille ni rang), et la compression se fait par division de chemin, elle aussi par CAS
+(un échec signifie simplement qu’un autre thread a déjà raccourci le chemin).*/
+
+uint32_t link_priority(int x){
+    return (uint32_t)x * 2654435761u;
+}
+
+int concurrent_find(partition_t *p, int x){
+    while (true) {
+        int parent = __atomic_load_n(&p->arr[x], __ATOMIC_ACQUIRE);
+        if (parent < 0) return x;
+        int grandparent = __atomic_load_n(&p->arr[parent], __ATOMIC_ACQUIRE);
+        if (grandparent < 0) return parent;
+        __atomic_compare_exchange_n(&p->arr[x], &parent, grandparent, false,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+        x = grandparent;
+    }
+}
+
+bool concurrent_merge(partition_t *p, int x, int y){
+    while (true) {
+        x = concurrent_find(p, x);
+        y = concurrent_find(p, y);
+        if (x == y) return false;
+        if (link_priority(x) > link_priority(y)) {
+            int tmp = x;
+            x = y;
+            y = tmp;
+        }
+        int root = -1;
+        if (__atomic_compare_exchange_n(&p->arr[x], &root, y, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            __atomic_fetch_sub(&p->nb_sets, 1, __ATOMIC_RELAXED);
+            return true;
+        }
+        // x a été rattachée entre-temps par un autre thread : on recommence
+    }
+}
+
+struct components_worker {
+    graph_t *g;
+    partition_t *part;
+    vertex lo;
+    vertex hi;
+};
+
+void *components_worker(void *arg){
+    struct components_worker *w = arg;
+    for (vertex x = w->lo; x < w->hi; x++) {
+        for (int i = 0; i < w->g->degrees[x]; i++) {
+            edge e = w->g->adj[x][i];
+            if (e.x < e.y) concurrent_merge(w->part, e.x, e.y);
+        }
+    }
+    return NULL;
+}
+
+/*fonction parallel_get_components qui a le même contrat que get_components (et donne
+exactement la même numérotation), les arêtes étant fusionnées par nb_threads threads*/
+
+int *parallel_get_components(graph_t *g, int *nb_components, int nb_threads){
+    partition_t *part = partition_new(g->n);
+    pthread_t *threads = malloc(nb_threads * sizeof(pthread_t));
+    struct components_worker *workers = malloc(nb_threads * sizeof(struct components_worker));
+    for (int t = 0; t < nb_threads; t++) {
+        workers[t].g = g;
+        workers[t].part = part;
+        workers[t].lo = (long long)g->n * t / nb_threads;
+        workers[t].hi = (long long)g->n * (t + 1) / nb_threads;
+        if (t > 0) pthread_create(&threads[t], NULL, components_worker, &workers[t]);
+    }
+    components_worker(&workers[0]);
+    for (int t = 1; t < nb_threads; t++) pthread_join(threads[t], NULL);
+    int *arr = malloc(g->n * sizeof(int));
+    *nb_components = partition_labels(part, arr);
+    free(threads);
+    free(workers);
+    partition_free(part);
+    return arr;
+}
+
+
+
+/*fonction csr_lighter qui indique si l’arête d’indice i (d’origine xi) est strictement
+plus légère que celle d’indice j (d’origine xj), j = -1 désignant l’absence d’arête. Les
+égalités de poids sont départagées par les extrémités de l’arête, ce qui donne un ordre
+total sur les arêtes non orientées : c’est ce qui garantit que Boruvka ne crée pas de
+cycle. Les origines sont fournies par l’appelant, qui les connaît déjà.*/
+
+bool csr_lighter(csr_t *g, vertex xi, int i, vertex xj, int j){
+    if (j == -1) return true;
+    if (g->weights[i] != g->weights[j]) return g->weights[i] < g->weights[j];
+    vertex yi = g->targets[i];
+    vertex yj = g->targets[j];
+    vertex min_i = xi < yi ? xi : yi;
+    vertex min_j = xj < yj ? xj : yj;
+    if (min_i != min_j) return min_i < min_j;
+    return xi + yi - min_i < xj + yj - min_j;
+}
+
+/*Boruvka parallèle. Chaque tour se déroule en quatre phases séparées par des barrières :
+■ scan : chaque thread parcourt une tranche des listes d’adjacence et note dans sa propre
+table local[c] l’arête sortante la plus légère de chaque composante c ;
+■ réduction : chaque thread prend le minimum des tables locales pour une tranche de
+composantes, et note dans next[c] la composante visée ;
+■ accrochage : chaque racine c se rattache à next[c] (seule la plus petite des deux racines
+s’abstient quand deux composantes se choisissent mutuellement) ;
+■ saut de pointeurs : chaque sommet remonte jusqu’à sa racine.
+Une racine n’écrit que dans sa propre case de parent, l’accrochage ne demande donc
+aucune synchronisation en dehors des barrières.*/
+
+struct parallel_boruvka {
+    csr_t *g;
+    int nb_threads;
+    int *parent;
+    int **local;
+    vertex **local_source;
+    int *best;
+    vertex *best_source;
+    int *next;
+    edge *mst;
+    int nb_chosen;
+    int nb_hooked;
+    pthread_barrier_t barrier;
+};
+
+struct boruvka_worker {
+    struct parallel_boruvka *pb;
+    int id;
+};
+
+/*fonction csr_split qui renvoie le premier sommet de la tranche numéro k (sur
+nb_slices) quand on découpe le graphe en tranches contenant autant d’arêtes*/
+
+vertex csr_split(csr_t *g, int k, int nb_slices){
+    if (k >= nb_slices) return g->n;
+    long long target = (long long)g->offsets[g->n] * k / nb_slices;
+    int lo = 0;
+    int hi = g->n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (g->offsets[mid] < target) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void *boruvka_worker(void *arg){
+    struct boruvka_worker *w = arg;
+    struct parallel_boruvka *pb = w->pb;
+    csr_t *g = pb->g;
+    int *local = pb->local[w->id];
+    vertex *local_source = pb->local_source[w->id];
+    vertex scan_lo = csr_split(g, w->id, pb->nb_threads);
+    vertex scan_hi = csr_split(g, w->id + 1, pb->nb_threads);
+    int lo = (long long)g->n * w->id / pb->nb_threads;
+    int hi = (long long)g->n * (w->id + 1) / pb->nb_threads;
+    while (true) {
+        for (vertex x = scan_lo; x < scan_hi; x++) {
+            int c = pb->parent[x];
+            for (int i = g->offsets[x]; i < g->offsets[x + 1]; i++) {
+                if (pb->parent[g->targets[i]] != c &&
+                    csr_lighter(g, x, i, local_source[c], local[c])) {
+                    local[c] = i;
+                    local_source[c] = x;
+                }
+            }
+        }
+        pthread_barrier_wait(&pb->barrier);
+
+        for (int c = lo; c < hi; c++) {
+            int best = -1;
+            vertex best_source = -1;
+            for (int t = 0; t < pb->nb_threads; t++) {
+                int i = pb->local[t][c];
+                vertex x = pb->local_source[t][c];
+                if (i != -1 && csr_lighter(g, x, i, best_source, best)) {
+                    best = i;
+                    best_source = x;
+                }
+                pb->local[t][c] = -1;
+            }
+            pb->best[c] = best;
+            pb->best_source[c] = best_source;
+            pb->next[c] = best == -1 ? c : pb->parent[g->targets[best]];
+        }
+        pthread_barrier_wait(&pb->barrier);
+
+        int nb_hooked = 0;
+        for (int c = lo; c < hi; c++) {
+            if (pb->best[c] == -1) continue;
+            int d = pb->next[c];
+            if (pb->next[d] == c && c < d) continue;
+            pb->parent[c] = d;
+            int i = pb->best[c];
+            edge e = {.x = pb->best_source[c], .y = g->targets[i], .rho = g->weights[i]};
+            pb->mst[__atomic_fetch_add(&pb->nb_chosen, 1, __ATOMIC_RELAXED)] = e;
+            nb_hooked++;
+        }
+        __atomic_fetch_add(&pb->nb_hooked, nb_hooked, __ATOMIC_RELAXED);
+        pthread_barrier_wait(&pb->barrier);
+
+        for (vertex x = lo; x < hi; x++) {
+            int r = __atomic_load_n(&pb->parent[x], __ATOMIC_RELAXED);
+            int up = __atomic_load_n(&pb->parent[r], __ATOMIC_RELAXED);
+            while (up != r) {
+                r = up;
+                up = __atomic_load_n(&pb->parent[r], __ATOMIC_RELAXED);
+            }
+            __atomic_store_n(&pb->parent[x], r, __ATOMIC_RELAXED);
+        }
+        pthread_barrier_wait(&pb->barrier);
+
+        int hooked = pb->nb_hooked;
+        pthread_barrier_wait(&pb->barrier);
+        if (w->id == 0) pb->nb_hooked = 0;
+        if (hooked == 0) break;
+    }
+    return NULL;
+}
+
+/*fonction parallel_boruvka qui calcule une forêt couvrante minimale de g avec
+nb_threads threads ; même contrat de sortie que kruskal*/
+
+edge *parallel_boruvka(csr_t *g, int nb_threads, int *nb_chosen){
+    struct parallel_boruvka pb;
+    pb.g = g;
+    pb.nb_threads = nb_threads;
+    pb.parent = malloc(g->n * sizeof(int));
+    pb.best = malloc(g->n * sizeof(int));
+    pb.best_source = malloc(g->n * sizeof(vertex));
+    pb.next = malloc(g->n * sizeof(int));
+    pb.local = malloc(nb_threads * sizeof(int*));
+    pb.local_source = malloc(nb_threads * sizeof(vertex*));
+    pb.mst = malloc((g->n - 1) * sizeof(edge));
+    pb.nb_chosen = 0;
+    pb.nb_hooked = 0;
+    for (vertex x = 0; x < g->n; x++) pb.parent[x] = x;
+    for (int t = 0; t < nb_threads; t++) {
+        pb.local[t] = malloc(g->n * sizeof(int));
+        pb.local_source[t] = malloc(g->n * sizeof(vertex));
+        for (int c = 0; c < g->n; c++) pb.local[t][c] = -1;
+    }
+    pthread_barrier_init(&pb.barrier, NULL, nb_threads);
+    pthread_t *threads = malloc(nb_threads * sizeof(pthread_t));
+    struct boruvka_worker *workers = malloc(nb_threads * sizeof(struct boruvka_worker));
+    for (int t = 0; t < nb_threads; t++) {
+        workers[t].pb = &pb;
+        workers[t].id = t;
+        if (t > 0) pthread_create(&threads[t], NULL, boruvka_worker, &workers[t]);
+    }
+    boruvka_worker(&workers[0]);
+    for (int t = 1; t < nb_threads; t++) pthread_join(threads[t], NULL);
+    pthread_barrier_destroy(&pb.barrier);
+    for (int t = 0; t < nb_threads; t++) {
+        free(pb.local[t]);
+        free(pb.local_source[t]);
+    }
+    free(pb.local);
+    free(pb.local_source);
+    free(pb.parent);
+    free(pb.best);
+    free(pb.best_source);
+    free(pb.next);
+    free(threads);
+    free(workers);
+    *nb_chosen = pb.nb_chosen;
+    return pb.mst;
+}
+
+
+
+/*Filter-Kruskal : plutôt que de trier toutes les arêtes, on les partitionne autour d’un
+pivot, on traite récursivement les arêtes légères, puis on retire des arêtes lourdes
+celles dont les extrémités sont déjà reliées avant de les traiter à leur tour. Sur un
+graphe dense, la plupart des arêtes lourdes sont ainsi éliminées sans jamais être triées.
+Au-delà de PARALLEL_PARTITION_THRESHOLD arêtes, le partitionnement est réparti entre
+plusieurs threads.*/
+
+#define FILTER_KRUSKAL_THRESHOLD 1024
+#define PARALLEL_PARTITION_THRESHOLD (1 << 16)
+
+struct partition_slice {
+    edge *arr;
+    edge *tmp;
+    int lo;
+    int hi;
+    weight_t w;
+    int nb_light;
+    int light_index;
+    int heavy_index;
+};
+
+void *count_light(void *arg){
+    struct partition_slice *s = arg;
+    s->nb_light = 0;
+    for (int i = s->lo; i < s->hi; i++) {
+        if (s->arr[i].rho <= s->w) s->nb_light++;
+    }
+    return NULL;
+}
+
+void *scatter_slice(void *arg){
+    struct partition_slice *s = arg;
+    for (int i = s->lo; i < s->hi; i++) {
+        if (s->arr[i].rho <= s->w) {
+            s->tmp[s->light_index] = s->arr[i];
+            s->light_index++;
+        } else {
+            s->tmp[s->heavy_index] = s->arr[i];
+            s->heavy_index++;
+        }
+    }
+    return NULL;
+}
+
+void run_slices(void *(*f)(void *), struct partition_slice *slices, int nb_threads){
+    pthread_t *threads = malloc(nb_threads * sizeof(pthread_t));
+    for (int t = 1; t < nb_threads; t++) {
+        pthread_create(&threads[t], NULL, f, &slices[t]);
+    }
+    f(&slices[0]);
+    for (int t = 1; t < nb_threads; t++) pthread_join(threads[t], NULL);
+    free(threads);
+}
+
+/*fonction parallel_partition qui place en tête de arr (de longueur len) les arêtes de
+poids inférieur ou égal à w, suivies des autres, et renvoie le nombre d’arêtes légères.
+tmp est un tampon d’au moins len arêtes.*/
+
+int parallel_partition(edge *arr, edge *tmp, int len, weight_t w, int nb_threads){
+    struct partition_slice *slices = calloc(nb_threads, sizeof(struct partition_slice));
+    for (int t = 0; t < nb_threads; t++) {
+        slices[t].arr = arr;
+        slices[t].tmp = tmp;
+        slices[t].lo = (long long)len * t / nb_threads;
+        slices[t].hi = (long long)len * (t + 1) / nb_threads;
+        slices[t].w = w;
+    }
+    run_slices(count_light, slices, nb_threads);
+    int nb_light = 0;
+    for (int t = 0; t < nb_threads; t++) nb_light += slices[t].nb_light;
+    int light_index = 0;
+    int heavy_index = nb_light;
+    for (int t = 0; t < nb_threads; t++) {
+        slices[t].light_index = light_index;
+        slices[t].heavy_index = heavy_index;
+        light_index += slices[t].nb_light;
+        heavy_index += slices[t].hi - slices[t].lo - slices[t].nb_light;
+    }
+    run_slices(scatter_slice, slices, nb_threads);
+    memcpy(arr, tmp, len * sizeof(edge));
+    free(slices);
+    return nb_light;
+}
+
+struct filter_kruskal {
+    partition_t *part;
+    edge *mst;
+    int nb_chosen;
+    edge *tmp;
+    int nb_threads;
+};
+
+/*fonction filter_edges qui retire du tableau edges les arêtes internes à un ensemble
+de part, et renvoie le nombre d’arêtes restantes*/
+
+int filter_edges(partition_t *part, edge *edges, int p){
+    int next_index = 0;
+    for (int i = 0; i < p; i++) {
+        int rx, ry;
+        find_pair(part, edges[i].x, edges[i].y, &rx, &ry);
+        if (rx != ry) {
+            edges[next_index] = edges[i];
+            next_index++;
+        }
+    }
+    return next_index;
+}
+
+void filter_kruskal_rec(struct filter_kruskal *fk, edge *edges, int p){
+    if (nb_sets(fk->part) == 1 || p == 0) return;
+    if (p <= FILTER_KRUSKAL_THRESHOLD) {
+        sort_edges(edges, p);
+        fk->nb_chosen = kruskal_scan(fk->part, edges, p, fk->mst, fk->nb_chosen);
+        return;
+    }
+    // pivot : médiane du premier, du milieu et du dernier poids, placée en tête
+    // comme l’attend partition
+    int a = 0;
+    int b = p / 2;
+    int c = p - 1;
+    if (edges[a].rho > edges[b].rho) { int tmp = a; a = b; b = tmp; }
+    if (edges[b].rho > edges[c].rho) b = c;
+    if (edges[a].rho > edges[b].rho) b = a;
+    swap_edges(edges, 0, b);
+    int nb_light;
+    if (fk->nb_threads > 1 && p >= PARALLEL_PARTITION_THRESHOLD) {
+        nb_light = parallel_partition(edges, fk->tmp, p, edges[0].rho, fk->nb_threads);
+    } else {
+        nb_light = partition(edges, p) + 1;
+    }
+    if (nb_light == p) {
+        // tous les poids sont inférieurs au pivot (typiquement, beaucoup d’égalités)
+        sort_edges(edges, p);
+        fk->nb_chosen = kruskal_scan(fk->part, edges, p, fk->mst, fk->nb_chosen);
+        return;
+    }
+    filter_kruskal_rec(fk, edges, nb_light);
+    int nb_heavy = filter_edges(fk->part, edges + nb_light, p - nb_light);
+    filter_kruskal_rec(fk, edges + nb_light, nb_heavy);
+}
+
+edge *filter_kruskal(csr_t *g, int nb_threads, int *nb_chosen){
+    int p;
+    edge *edges = csr_get_edges(g, &p);
+    struct filter_kruskal fk;
+    fk.part = partition_new(g->n);
+    fk.mst = malloc((g->n - 1) * sizeof(edge));
+    fk.nb_chosen = 0;
+    fk.tmp = malloc(p * sizeof(edge));
+    fk.nb_threads = nb_threads;
+    filter_kruskal_rec(&fk, edges, p);
+    free(edges);
+    free(fk.tmp);
+    partition_free(fk.part);
+    *nb_chosen = fk.nb_chosen;
+    return fk.mst;
+}
+
+/*Tas d’arité HEAP_ARITY indexé par les sommets, stocké dans des tableaux plats :
+heap[i] est le sommet en position i, position[x] la position de x dans heap (-1 s’il n’y
+est pas) et key[x] sa priorité. Les fils de la position i sont les positions
+HEAP_ARITY * i + 1 ... HEAP_ARITY * i + HEAP_ARITY. Une arité de 4 divise la hauteur par
+deux par rapport à un tas binaire, et les fils d’un nœud tiennent dans une ligne de cache.*/
+
+#define HEAP_ARITY 4
+
+struct dheap {
+    int size;
+    vertex *heap;
+    int *position;
+    weight_t *key;
+};
+
+typedef struct dheap dheap_t;
+
+dheap_t *dheap_new(int capacity){
+    dheap_t *h = malloc(sizeof(dheap_t));
+    h->size = 0;
+    h->heap = malloc(capacity * sizeof(vertex));
+    h->position = malloc(capacity * sizeof(int));
+    h->key = malloc(capacity * sizeof(weight_t));
+    for (int x = 0; x < capacity; x++) {
+        h->position[x] = -1;
+        h->key[x] = INFINITY;
+    }
+    return h;
+}
+
+void dheap_free(dheap_t *h){
+    free(h->heap);
+    free(h->position);
+    free(h->key);
+    free(h);
+}
+
+void dheap_sift_up(dheap_t *h, int i){
+    vertex x = h->heap[i];
+    while (i > 0) {
+        int parent = (i - 1) / HEAP_ARITY;
+        vertex y = h->heap[parent];
+        if (h->key[y] <= h->key[x]) break;
+        h->heap[i] = y;
+        h->position[y] = i;
+        i = parent;
+    }
+    h->heap[i] = x;
+    h->position[x] = i;
+}
+
+void dheap_sift_down(dheap_t *h, int i){
+    vertex x = h->heap[i];
+    while (true) {
+        int first = HEAP_ARITY * i + 1;
+        if (first >= h->size) break;
+        int last = first + HEAP_ARITY < h->size ? first + HEAP_ARITY : h->size;
+        int smallest = first;
+        for (int j = first + 1; j < last; j++) {
+            if (h->key[h->heap[j]] < h->key[h->heap[smallest]]) smallest = j;
+        }
+        vertex y = h->heap[smallest];
+        if (h->key[y] >= h->key[x]) break;
+        h->heap[i] = y;
+        h->position[y] = i;
+        i = smallest;
+    }
+    h->heap[i] = x;
+    h->position[x] = i;
+}
+
+/*fonction dheap_push_or_decrease qui insère x avec la priorité key s’il n’est pas dans
+le tas, ou diminue sa priorité à key si elle était plus grande*/
+
+void dheap_push_or_decrease(dheap_t *h, vertex x, weight_t key){
+    if (h->position[x] == -1) {
+        h->key[x] = key;
+        h->heap[h->size] = x;
+        h->size++;
+        dheap_sift_up(h, h->size - 1);
+    } else if (key < h->key[x]) {
+        h->key[x] = key;
+        dheap_sift_up(h, h->position[x]);
+    }
+}
+
+vertex dheap_pop(dheap_t *h){
+    assert(h->size > 0);
+    vertex x = h->heap[0];
+    h->position[x] = -1;
+    h->size--;
+    if (h->size > 0) {
+        h->heap[0] = h->heap[h->size];
+        dheap_sift_down(h, 0);
+    }
+    return x;
+}
+
+/*fonction prim qui calcule une forêt couvrante minimale par l’algorithme de Prim,
+en faisant croître un arbre depuis chaque sommet non encore atteint. Même contrat de
+sortie que kruskal.*/
+
+edge *prim(csr_t *g, int *nb_chosen){
+    dheap_t *h = dheap_new(g->n);
+    vertex *from = malloc(g->n * sizeof(vertex));
+    bool *in_tree = calloc(g->n, sizeof(bool));
+    edge *mst = malloc((g->n - 1) * sizeof(edge));
+    int next_index = 0;
+    for (vertex root = 0; root < g->n; root++) {
+        if (in_tree[root]) continue;
+        from[root] = -1;
+        dheap_push_or_decrease(h, root, 0.);
+        while (h->size > 0) {
+            vertex x = dheap_pop(h);
+            in_tree[x] = true;
+            if (from[x] != -1) {
+                edge e = {.x = from[x], .y = x, .rho = h->key[x]};
+                mst[next_index] = e;
+                next_index++;
+            }
+            for (int i = g->offsets[x]; i < g->offsets[x + 1]; i++) {
+                vertex y = g->targets[i];
+                if (in_tree[y]) continue;
+                if (h->position[y] == -1 || g->weights[i] < h->key[y]) {
+                    from[y] = x;
+                    dheap_push_or_decrease(h, y, g->weights[i]);
+                }
+            }
+        }
+    }
+    free(from);
+    free(in_tree);
+    dheap_free(h);
+    *nb_chosen = next_index;
+    return mst;
+}
+
+/*Maintien incrémental d’une forêt couvrante minimale sous insertions d’arêtes, à l’aide
+d’un arbre lien-coupe (link-cut tree de Sleator et Tarjan). Chaque sommet x de la forêt
+est un nœud x, et chaque arête de la forêt est elle-même un nœud (d’indice n à 2n - 2)
+placé entre ses deux extrémités : le poids d’un chemin se lit ainsi sur les nœuds, et
+argmax[k] désigne le nœud de plus grand poids du sous-arbre de k dans son arbre splay.
+Quand on insère une arête {x, y} :
+■ si x et y ne sont pas reliés, on l’ajoute ;
+■ sinon, on cherche l’arête de poids maximal sur le chemin de x à y dans la forêt et on la
+remplace par la nouvelle si celle-ci est plus légère.
+Chaque insertion coûte O(log n) amorti. Les nœuds d’arête libérés sont réutilisés.*/
+
+struct dynamic_mst {
+    int n;
+    int *left;
+    int *right;
+    int *parent;
+    bool *reversed;
+    int *argmax;
+    weight_t *value;
+    edge *edges;
+    int *free_nodes;
+    int nb_free;
+    int *stack;
+    int nb_edges;
+    // somme compensée : elle subit des millions d’ajouts et de retraits
+    struct compensated_sum total;
+};
+
+typedef struct dynamic_mst dynamic_mst_t;
+
+dynamic_mst_t *dynamic_mst_new(int n){
+    dynamic_mst_t *d = malloc(sizeof(dynamic_mst_t));
+    int capacity = 2 * n - 1;
+    d->n = n;
+    d->left = malloc(capacity * sizeof(int));
+    d->right = malloc(capacity * sizeof(int));
+    d->parent = malloc(capacity * sizeof(int));
+    d->reversed = calloc(capacity, sizeof(bool));
+    d->argmax = malloc(capacity * sizeof(int));
+    d->value = malloc(capacity * sizeof(weight_t));
+    d->edges = malloc((n - 1) * sizeof(edge));
+    d->free_nodes = malloc((n - 1) * sizeof(int));
+    d->stack = malloc(capacity * sizeof(int));
+    for (int k = 0; k < capacity; k++) {
+        d->left[k] = -1;
+        d->right[k] = -1;
+        d->parent[k] = -1;
+        d->argmax[k] = k;
+        d->value[k] = -INFINITY;
+    }
+    d->nb_free = n - 1;
+    for (int i = 0; i < n - 1; i++) {
+        d->free_nodes[i] = 2 * n - 2 - i;
+        d->edges[i].x = -1;
+    }
+    d->nb_edges = 0;
+    d->total.s = 0.;
+    d->total.c = 0.;
+    return d;
+}
+
+void dynamic_mst_free(dynamic_mst_t *d){
+    free(d->left);
+    free(d->right);
+    free(d->parent);
+    free(d->reversed);
+    free(d->argmax);
+    free(d->value);
+    free(d->edges);
+    free(d->free_nodes);
+    free(d->stack);
+    free(d);
+}
+
+bool lct_is_root(dynamic_mst_t *d, int x){
+    int p = d->parent[x];
+    return p == -1 || (d->left[p] != x && d->right[p] != x);
+}
+
+void lct_push(dynamic_mst_t *d, int x){
+    if (!d->reversed[x]) return;
+    int tmp = d->left[x];
+    d->left[x] = d->right[x];
+    d->right[x] = tmp;
+    if (d->left[x] != -1) d->reversed[d->left[x]] ^= true;
+    if (d->right[x] != -1) d->reversed[d->right[x]] ^= true;
+    d->reversed[x] = false;
+}
+
+void lct_update(dynamic_mst_t *d, int x){
+    int best = x;
+    int l = d->left[x];
+    int r = d->right[x];
+    if (l != -1 && d->value[d->argmax[l]] > d->value[best]) best = d->argmax[l];
+    if (r != -1 && d->value[d->argmax[r]] > d->value[best]) best = d->argmax[r];
+    d->argmax[x] = best;
+}
+
+void lct_rotate(dynamic_mst_t *d, int x){
+    int p = d->parent[x];
+    int g = d->parent[p];
+    bool p_was_root = lct_is_root(d, p);
+    if (d->left[p] == x) {
+        d->left[p] = d->right[x];
+        if (d->right[x] != -1) d->parent[d->right[x]] = p;
+        d->right[x] = p;
+    } else {
+        d->right[p] = d->left[x];
+        if (d->left[x] != -1) d->parent[d->left[x]] = p;
+        d->left[x] = p;
+    }
+    d->parent[p] = x;
+    d->parent[x] = g;
+    if (!p_was_root) {
+        if (d->left[g] == p) d->left[g] = x;
+        else d->right[g] = x;
+    }
+    lct_update(d, p);
+    lct_update(d, x);
+}
+
+void lct_splay(dynamic_mst_t *d, int x){
+    // on propage d’abord les inversions en attente, de la racine de l’arbre splay vers x
+    int length = 0;
+    int y = x;
+    d->stack[length++] = y;
+    while (!lct_is_root(d, y)) {
+        y = d->parent[y];
+        d->stack[length++] = y;
+    }
+    while (length > 0) lct_push(d, d->stack[--length]);
+    while (!lct_is_root(d, x)) {
+        int p = d->parent[x];
+        if (!lct_is_root(d, p)) {
+            int g = d->parent[p];
+            if ((d->left[g] == p) == (d->left[p] == x)) lct_rotate(d, p);
+            else lct_rotate(d, x);
+        }
+        lct_rotate(d, x);
+    }
+}
+
+void lct_access(dynamic_mst_t *d, int x){
+    int last = -1;
+    for (int y = x; y != -1; y = d->parent[y]) {
+        lct_splay(d, y);
+        d->right[y] = last;
+        lct_update(d, y);
+        last = y;
+    }
+    lct_splay(d, x);
+}
+
+void lct_make_root(dynamic_mst_t *d, int x){
+    lct_access(d, x);
+    d->reversed[x] ^= true;
+}
+
+int lct_find_root(dynamic_mst_t *d, int x){
+    lct_access(d, x);
+    lct_push(d, x);
+    while (d->left[x] != -1) {
+        x = d->left[x];
+        lct_push(d, x);
+    }
+    lct_splay(d, x);
+    return x;
+}
+
+void lct_link(dynamic_mst_t *d, int x, int y){
+    lct_make_root(d, x);
+    d->parent[x] = y;
+}
+
+/*Précondition : x et y sont adjacents dans la forêt*/
+
+void lct_cut(dynamic_mst_t *d, int x, int y){
+    lct_make_root(d, x);
+    lct_access(d, y);
+    d->left[y] = -1;
+    d->parent[x] = -1;
+    lct_update(d, y);
+}
+
+void dynamic_mst_add(dynamic_mst_t *d, edge e){
+    int k = d->free_nodes[--d->nb_free];
+    d->value[k] = e.rho;
+    d->argmax[k] = k;
+    d->edges[k - d->n] = e;
+    lct_link(d, e.x, k);
+    lct_link(d, k, e.y);
+    d->nb_edges++;
+    neumaier_add(&d->total, e.rho);
+}
+
+/*fonction dynamic_mst_insert qui insère l’arête e dans le graphe et met à jour la forêt
+couvrante minimale ; elle renvoie true si la forêt a changé*/
+
+bool dynamic_mst_insert(dynamic_mst_t *d, edge e){
+    if (e.x == e.y) return false;
+    if (lct_find_root(d, e.x) != lct_find_root(d, e.y)) {
+        dynamic_mst_add(d, e);
+        return true;
+    }
+    lct_make_root(d, e.x);
+    lct_access(d, e.y);
+    int k = d->argmax[e.y];
+    if (d->value[k] <= e.rho) return false;
+    edge old = d->edges[k - d->n];
+    lct_cut(d, old.x, k);
+    lct_cut(d, k, old.y);
+    d->edges[k - d->n].x = -1;
+    d->free_nodes[d->nb_free++] = k;
+    d->nb_edges--;
+    neumaier_add(&d->total, -old.rho);
+    dynamic_mst_add(d, e);
+    return true;
+}
+
+weight_t dynamic_mst_total_weight(dynamic_mst_t *d){
+    return d->total.s + d->total.c;
+}
+
+/*fonction dynamic_mst_edges qui renvoie un bloc alloué contenant les arêtes de la forêt
+courante, et fixe *nb_edges à leur nombre*/
+
+edge *dynamic_mst_edges(dynamic_mst_t *d, int *nb_edges){
+    edge *arr = malloc(d->nb_edges * sizeof(edge));
+    int next_index = 0;
+    for (int i = 0; i < d->n - 1; i++) {
+        if (d->edges[i].x != -1) {
+            arr[next_index] = d->edges[i];
+            next_index++;
+        }
+    }
+    *nb_edges = next_index;
+    return arr;
+}
+
+/*Calcul semi-externe : seul le tableau de la partition (et la forêt résultat) est en
+mémoire, les arêtes restant sur disque. Les arêtes sont lues dans un fichier d’arêtes
+(un en-tête edge_file_header suivi des arêtes, au format de la structure edge), par
+paquets d’au plus memory_budget octets qui sont triés puis écrits dans un fichier
+temporaire (les « séquences »). Les séquences sont ensuite fusionnées (fusion à k voies
+par un tas binaire, chaque séquence étant lue par un tampon d’environ memory_budget / k
+octets) et les arêtes parviennent ainsi à union-find par poids croissant.*/
+
+#define EDGE_FILE_MAGIC 0x4553534d
+#define MIN_RUN_BUFFER 64
+
+struct edge_file_header {
+    uint32_t magic;
+    uint32_t weight_size;
+    int64_t n;
+    int64_t m;
+};
+
+/*fonction write_edge_file qui enregistre les arêtes de g dans le fichier path, et
+renvoie false en cas d’erreur*/
+
+bool write_edge_file(csr_t *g, const char *path){
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) return false;
+    // les boucles ne sont pas écrites, et ne doivent donc pas être comptées dans m
+    int m = 0;
+    for (vertex x = 0; x < g->n; x++) {
+        for (int i = g->offsets[x]; i < g->offsets[x + 1]; i++) {
+            if (x < g->targets[i]) m++;
+        }
+    }
+    struct edge_file_header h = {.magic = EDGE_FILE_MAGIC, .weight_size = sizeof(weight_t),
+                                 .n = g->n, .m = m};
+    fwrite(&h, sizeof(h), 1, f);
+    for (vertex x = 0; x < g->n; x++) {
+        for (int i = g->offsets[x]; i < g->offsets[x + 1]; i++) {
+            if (x < g->targets[i]) {
+                edge e = {.x = x, .y = g->targets[i], .rho = g->weights[i]};
+                fwrite(&e, sizeof(edge), 1, f);
+            }
+        }
+    }
+    bool ok = !ferror(f);
+    return fclose(f) == 0 && ok;
+}
+
+struct run {
+    long start;
+    long length;
+    long next;
+    edge *buffer;
+    int buffer_length;
+    int buffer_index;
+};
+
+/*fonction run_refill qui recharge le tampon d’une séquence ; renvoie false si la
+séquence est épuisée ou si la lecture a échoué (r->next < r->length dans ce cas)*/
+
+bool run_refill(FILE *tmp, struct run *r, int capacity){
+    if (r->next == r->length) return false;
+    long count = r->length - r->next < capacity ? r->length - r->next : capacity;
+    fseek(tmp, (r->start + r->next) * sizeof(edge), SEEK_SET);
+    if (fread(r->buffer, sizeof(edge), count, tmp) != (size_t)count) return false;
+    r->next += count;
+    r->buffer_length = count;
+    r->buffer_index = 0;
+    return true;
+}
+
+weight_t run_head(struct run *runs, int i){
+    return runs[i].buffer[runs[i].buffer_index].rho;
+}
+
+void run_heap_sift_down(struct run *runs, int *heap, int size, int i){
+    while (true) {
+        int smallest = i;
+        int l = 2 * i + 1;
+        int r = 2 * i + 2;
+        if (l < size && run_head(runs, heap[l]) < run_head(runs, heap[smallest])) smallest = l;
+        if (r < size && run_head(runs, heap[r]) < run_head(runs, heap[smallest])) smallest = r;
+        if (smallest == i) return;
+        int tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+/*fonction external_kruskal qui calcule la forêt couvrante minimale du graphe stocké
+dans le fichier d’arêtes path en n’utilisant qu’environ memory_budget octets pour les
+arêtes. Elle fixe *n au nombre de sommets du graphe et renvoie NULL en cas d’erreur.*/
+
+edge *external_kruskal(const char *path, size_t memory_budget, int *n, int *nb_chosen){
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) return NULL;
+    struct edge_file_header h;
+    if (fread(&h, sizeof(h), 1, in) != 1 || h.magic != EDGE_FILE_MAGIC ||
+        h.weight_size != sizeof(weight_t) || h.n < 0 || h.n > INT_MAX || h.m < 0 || h.m > INT_MAX) {
+        fclose(in);
+        return NULL;
+    }
+    FILE *tmp = tmpfile();
+    if (tmp == NULL) {
+        fclose(in);
+        return NULL;
+    }
+    size_t chunk = memory_budget / sizeof(edge);
+    if (chunk > (size_t)h.m) chunk = h.m;
+    if (chunk < MIN_RUN_BUFFER) chunk = MIN_RUN_BUFFER;
+    int nb_runs = (h.m + chunk - 1) / chunk;
+    struct run *runs = malloc(nb_runs * sizeof(struct run));
+    edge *buffer = malloc(chunk * sizeof(edge));
+    long start = 0;
+    bool ok = true;
+    for (int i = 0; i < nb_runs; i++) {
+        size_t length = fread(buffer, sizeof(edge), chunk, in);
+        for (size_t j = 0; j < length; j++) {
+            if (buffer[j].x < 0 || buffer[j].x >= h.n || buffer[j].y < 0 || buffer[j].y >= h.n) {
+                ok = false;
+            }
+        }
+        sort_edges(buffer, length);
+        fwrite(buffer, sizeof(edge), length, tmp);
+        runs[i].start = start;
+        runs[i].length = length;
+        runs[i].next = 0;
+        start += length;
+    }
+    // un fichier tronqué donnerait sinon une forêt partielle, sans erreur
+    ok = ok && start == h.m && fflush(tmp) == 0 && !ferror(tmp);
+    free(buffer);
+    fclose(in);
+    if (!ok) {
+        free(runs);
+        fclose(tmp);
+        return NULL;
+    }
+
+    size_t run_buffer = memory_budget / ((nb_runs > 0 ? nb_runs : 1) * sizeof(edge));
+    if (run_buffer < MIN_RUN_BUFFER) run_buffer = MIN_RUN_BUFFER;
+    if (run_buffer > chunk) run_buffer = chunk;
+    int capacity = run_buffer;
+    int *heap = malloc(nb_runs * sizeof(int));
+    int size = 0;
+    for (int i = 0; i < nb_runs; i++) {
+        runs[i].buffer = malloc(capacity * sizeof(edge));
+        if (run_refill(tmp, &runs[i], capacity)) {
+            heap[size] = i;
+            size++;
+        } else if (runs[i].next < runs[i].length) {
+            ok = false;
+        }
+    }
+    for (int i = size / 2 - 1; i >= 0; i--) run_heap_sift_down(runs, heap, size, i);
+
+    partition_t *part = partition_new(h.n);
+    edge *mst = malloc((h.n > 0 ? h.n - 1 : 0) * sizeof(edge));
+    int next_index = 0;
+    while (ok && size > 0 && nb_sets(part) > 1) {
+        struct run *r = &runs[heap[0]];
+        edge e = r->buffer[r->buffer_index];
+        if (merge_rank(part, e.x, e.y)) {
+            mst[next_index] = e;
+            next_index++;
+        }
+        r->buffer_index++;
+        if (r->buffer_index == r->buffer_length && !run_refill(tmp, r, capacity)) {
+            ok = r->next == r->length;
+            size--;
+            heap[0] = heap[size];
+        }
+        run_heap_sift_down(runs, heap, size, 0);
+    }
+
+    for (int i = 0; i < nb_runs; i++) free(runs[i].buffer);
+    free(runs);
+    free(heap);
+    fclose(tmp);
+    partition_free(part);
+    if (!ok) {
+        free(mst);
+        return NULL;
+    }
+    *n = h.n;
+    *nb_chosen = next_index;
+    return mst;
+}
+
+/*Boruvka par contraction : après chaque tour, chaque composante de la forêt devient un
+sommet unique (numéroté comme dans get_components), les boucles sont supprimées et, entre
+deux composantes, seule l’arête la plus légère est conservée. Le graphe de travail (une
+simple liste d’arêtes) diminue donc géométriquement d’un tour à l’autre, et il n’y a plus
+de graphe T à maintenir. Chaque arête de travail retient l’indice id de l’arête d’origine
+qu’elle représente ; id sert aussi à départager les poids égaux. Les arêtes parallèles
+sont regroupées par deux tris par dénombrement (sur y puis sur x), en O(n + m) par tour.*/
+
+struct contracted_edge {
+    vertex x;
+    vertex y;
+    weight_t rho;
+    int id;
+};
+
+typedef struct contracted_edge contracted_edge;
+
+bool contracted_lighter(contracted_edge *e, contracted_edge *f){
+    if (e->rho != f->rho) return e->rho < f->rho;
+    return e->id < f->id;
+}
+
+/*fonction counting_sort_contracted qui trie de façon stable les m arêtes de src dans dst
+suivant l’extrémité x (si by_x) ou y, ces extrémités étant dans [0 . . . n − 1] ; counts
+est un tableau de travail de taille n + 1*/
+
+void counting_sort_contracted(contracted_edge *src, contracted_edge *dst, int m, int n,
+                              bool by_x, int *counts){
+    for (int v = 0; v <= n; v++) counts[v] = 0;
+    for (int i = 0; i < m; i++) counts[(by_x ? src[i].x : src[i].y) + 1]++;
+    for (int v = 0; v < n; v++) counts[v + 1] += counts[v];
+    for (int i = 0; i < m; i++) {
+        int v = by_x ? src[i].x : src[i].y;
+        dst[counts[v]] = src[i];
+        counts[v]++;
+    }
+}
+
+edge *contracting_boruvka(csr_t *g, int *nb_chosen){
+    int m;
+    edge *original = csr_get_edges(g, &m);
+    contracted_edge *work = malloc(m * sizeof(contracted_edge));
+    contracted_edge *tmp = malloc(m * sizeof(contracted_edge));
+    for (int i = 0; i < m; i++) {
+        contracted_edge e = {.x = original[i].x, .y = original[i].y, .rho = original[i].rho, .id = i};
+        work[i] = e;
+    }
+    int n = g->n;
+    int *best = malloc(n * sizeof(int));
+    int *labels = malloc(n * sizeof(int));
+    int *counts = malloc((n + 1) * sizeof(int));
+    edge *mst = malloc((g->n - 1) * sizeof(edge));
+    int next_index = 0;
+    while (m > 0) {
+        for (vertex x = 0; x < n; x++) best[x] = -1;
+        for (int i = 0; i < m; i++) {
+            contracted_edge *e = &work[i];
+            if (best[e->x] == -1 || contracted_lighter(e, &work[best[e->x]])) best[e->x] = i;
+            if (best[e->y] == -1 || contracted_lighter(e, &work[best[e->y]])) best[e->y] = i;
+        }
+        partition_t *part = partition_new(n);
+        for (vertex x = 0; x < n; x++) {
+            if (best[x] == -1) continue;
+            contracted_edge e = work[best[x]];
+            if (merge_rank(part, e.x, e.y)) {
+                mst[next_index] = original[e.id];
+                next_index++;
+            }
+        }
+        n = partition_labels(part, labels);
+        partition_free(part);
+        int nb_kept = 0;
+        for (int i = 0; i < m; i++) {
+            contracted_edge e = work[i];
+            e.x = labels[work[i].x];
+            e.y = labels[work[i].y];
+            if (e.x == e.y) continue;
+            if (e.x > e.y) {
+                vertex tmp = e.x;
+                e.x = e.y;
+                e.y = tmp;
+            }
+            work[nb_kept] = e;
+            nb_kept++;
+        }
+        counting_sort_contracted(work, tmp, nb_kept, n, false, counts);
+        counting_sort_contracted(tmp, work, nb_kept, n, true, counts);
+        m = 0;
+        for (int i = 0; i < nb_kept; i++) {
+            if (m > 0 && work[m - 1].x == work[i].x && work[m - 1].y == work[i].y) {
+                if (contracted_lighter(&work[i], &work[m - 1])) work[m - 1] = work[i];
+                continue;
+            }
+            work[m] = work[i];
+            m++;
+        }
+    }
+    free(original);
+    free(work);
+    free(tmp);
+    free(best);
+    free(labels);
+    free(counts);
+    *nb_chosen = next_index;
+    return mst;
+}
+
+/*Classification hiérarchique à lien simple. Le dendrogramme est un tableau plat de
+fusions, dans l’ordre des poids croissants : la fusion numéro i réunit les classes a et b
+(une classe d’indice c < n est le singleton {c}, la classe d’indice n + i est celle créée
+par la fusion numéro i) à la hauteur height, et la classe obtenue a size éléments. On
+retient aussi l’arête x–y de l’arbre couvrant qui a provoqué la fusion, ce qui permet de
+répondre aux requêtes de coupe en O(n) avec une partition, sans relancer kruskal.*/
+
+struct merge_step {
+    int a;
+    int b;
+    weight_t height;
+    int size;
+    vertex x;
+    vertex y;
+};
+
+struct dendrogram {
+    int n;
+    int nb_merges;
+    struct merge_step *merges;
+};
+
+typedef struct dendrogram dendrogram_t;
+
+/*fonction dendrogram_from_mst qui construit le dendrogramme à partir des len arêtes
+d’une forêt couvrante minimale d’un graphe à n sommets, triées par poids croissant
+(comme celles renvoyées par kruskal)*/
+
+dendrogram_t *dendrogram_from_mst(int n, edge *mst, int len){
+    dendrogram_t *d = malloc(sizeof(dendrogram_t));
+    d->n = n;
+    d->nb_merges = 0;
+    d->merges = malloc(len * sizeof(struct merge_step));
+    partition_t *part = partition_new(n);
+    int *cluster = malloc(n * sizeof(int));
+    int *size = malloc(n * sizeof(int));
+    for (vertex x = 0; x < n; x++) {
+        cluster[x] = x;
+        size[x] = 1;
+    }
+    for (int i = 0; i < len; i++) {
+        int rx, ry;
+        find_pair(part, mst[i].x, mst[i].y, &rx, &ry);
+        if (rx == ry) continue;
+        struct merge_step step = {.a = cluster[rx], .b = cluster[ry], .height = mst[i].rho,
+                                  .size = size[rx] + size[ry], .x = mst[i].x, .y = mst[i].y};
+        link_roots(part, rx, ry);
+        int r = find_halving(part, rx);
+        cluster[r] = n + d->nb_merges;
+        size[r] = step.size;
+        d->merges[d->nb_merges] = step;
+        d->nb_merges++;
+    }
+    free(cluster);
+    free(size);
+    partition_free(part);
+    return d;
+}
+
+/*fonction single_linkage qui calcule le dendrogramme du graphe g*/
+
+dendrogram_t *single_linkage(csr_t *g){
+    int nb_chosen;
+    edge *mst = csr_kruskal(g, &nb_chosen);
+    dendrogram_t *d = dendrogram_from_mst(g->n, mst, nb_chosen);
+    free(mst);
+    return d;
+}
+
+void dendrogram_free(dendrogram_t *d){
+    free(d->merges);
+    free(d);
+}
+
+/*fonction dendrogram_cut qui applique les nb_merges premières fusions et renvoie le
+numéro de classe de chaque sommet, avec les mêmes conventions que get_components*/
+
+int *dendrogram_cut(dendrogram_t *d, int nb_merges, int *nb_clusters){
+    partition_t *part = partition_new(d->n);
+    for (int i = 0; i < nb_merges; i++) {
+        merge_rank(part, d->merges[i].x, d->merges[i].y);
+    }
+    int *labels = malloc(d->n * sizeof(int));
+    *nb_clusters = partition_labels(part, labels);
+    partition_free(part);
+    return labels;
+}
+
+/*fonction cut_k qui découpe en k classes (ou en autant de composantes connexes que le
+graphe en a, si elles sont plus de k)*/
+
+int *cut_k(dendrogram_t *d, int k, int *nb_clusters){
+    int nb_merges = d->n - k;
+    if (nb_merges < 0) nb_merges = 0;
+    if (nb_merges > d->nb_merges) nb_merges = d->nb_merges;
+    return dendrogram_cut(d, nb_merges, nb_clusters);
+}
+
+/*fonction cut_threshold qui ne garde que les fusions de hauteur inférieure ou égale
+à threshold*/
+
+int *cut_threshold(dendrogram_t *d, weight_t threshold, int *nb_clusters){
+    int lo = 0;
+    int hi = d->nb_merges;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (d->merges[mid].height <= threshold) lo = mid + 1;
+        else hi = mid;
+    }
+    return dendrogram_cut(d, lo, nb_clusters);
+}
+
+/*Générateurs de graphes aléatoires (poids uniformes dans [0, 1[). Le générateur
+pseudo-aléatoire est splitmix64, pour que les graphes ne dépendent que de la graine.
+Les générateurs qui tirent des arêtes sans boucle renvoient NULL si n < 2, puisque toutes
+les arêtes tirées seraient alors des boucles.*/
+
+uint64_t random_next(uint64_t *state){
+    *state += 0x9E3779B97F4A7C15ULL;
+    uint64_t z = *state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+double random_weight(uint64_t *state){
+    return (random_next(state) >> 11) * 0x1.0p-53;
+}
+
+/*fonction random_graph qui renvoie un graphe à n sommets et m arêtes tirées
+uniformément (sans boucle, mais éventuellement avec des arêtes multiples)*/
+
+csr_t *random_graph(int n, int m, uint64_t seed){
+    if (n < 2) return NULL;
+    edge *edges = malloc(m * sizeof(edge));
+    for (int i = 0; i < m; i++) {
+        edge e;
+        do {
+            e.x = random_next(&seed) % n;
+            e.y = random_next(&seed) % n;
+        } while (e.x == e.y);
+        e.rho = random_weight(&seed);
+        edges[i] = e;
+    }
+    csr_t *g = csr_from_edges(n, edges, m);
+    free(edges);
+    return g;
+}
+
+/*fonction grid_graph qui renvoie la grille side × side (le sommet (i, j) porte le
+numéro i * side + j)*/
+
+csr_t *grid_graph(int side, uint64_t seed){
+    int m = 2 * side * (side - 1);
+    edge *edges = malloc(m * sizeof(edge));
+    int next_index = 0;
+    for (int i = 0; i < side; i++) {
+        for (int j = 0; j < side; j++) {
+            vertex x = i * side + j;
+            if (j + 1 < side) {
+                edge e = {.x = x, .y = x + 1, .rho = random_weight(&seed)};
+                edges[next_index++] = e;
+            }
+            if (i + 1 < side) {
+                edge e = {.x = x, .y = x + side, .rho = random_weight(&seed)};
+                edges[next_index++] = e;
+            }
+        }
+    }
+    csr_t *g = csr_from_edges(side * side, edges, m);
+    free(edges);
+    return g;
+}
+
+
+
+/*fonction rmat_graph qui renvoie un graphe R-MAT à m arêtes (loi de degrés en loi de
+puissance) : chaque arête est placée en descendant récursivement dans l’un des quatre
+quarts de la matrice d’adjacence, avec les probabilités RMAT_A, RMAT_B, RMAT_C et
+1 - RMAT_A - RMAT_B - RMAT_C. La matrice a pour côté la plus petite puissance de 2
+supérieure ou égale à n, et on retire les arêtes qui sortent de [0 . . . n − 1] ainsi que
+les boucles.*/
+
+#define RMAT_A 0.57
+#define RMAT_B 0.19
+#define RMAT_C 0.19
+
+csr_t *rmat_graph(int n, int m, uint64_t seed){
+    if (n < 2) return NULL;
+    int levels = 0;
+    while ((1LL << levels) < n) levels++;
+    edge *edges = malloc(m * sizeof(edge));
+    int next_index = 0;
+    while (next_index < m) {
+        vertex x = 0;
+        vertex y = 0;
+        for (int l = 0; l < levels; l++) {
+            double r = random_weight(&seed);
+            x = 2 * x + (r >= RMAT_A + RMAT_B);
+            y = 2 * y + ((r >= RMAT_A && r < RMAT_A + RMAT_B) || r >= RMAT_A + RMAT_B + RMAT_C);
+        }
+        if (x >= n || y >= n || x == y) continue;
+        edge e = {.x = x, .y = y, .rho = random_weight(&seed)};
+        edges[next_index] = e;
+        next_index++;
+    }
+    csr_t *g = csr_from_edges(n, edges, m);
+    free(edges);
+    return g;
+}
+
+/*fonction complete_graph qui renvoie le graphe complet à n sommets, ou NULL s’il a plus
+de INT_MAX arêtes*/
+
+csr_t *complete_graph(int n, uint64_t seed){
+    long long nb_edges = (long long)n * (n - 1) / 2;
+    if (nb_edges > INT_MAX) return NULL;
+    int m = nb_edges;
+    edge *edges = malloc(m * sizeof(edge));
+    int next_index = 0;
+    for (vertex x = 0; x < n; x++) {
+        for (vertex y = x + 1; y < n; y++) {
+            edge e = {.x = x, .y = y, .rho = random_weight(&seed)};
+            edges[next_index] = e;
+            next_index++;
+        }
+    }
+    csr_t *g = csr_from_edges(n, edges, m);
+    free(edges);
+    return g;
+}
+
+/*Générateurs sélectionnables pour les bancs d’essai, tous paramétrés par n, m et la
+graine (la grille a environ n sommets et ignore m, de même que le graphe complet)*/
+
+struct generator {
+    const char *name;
+    csr_t *(*make)(int n, int m, uint64_t seed);
+};
+
+typedef struct generator generator_t;
+
+csr_t *make_grid(int n, int m, uint64_t seed){
+    (void)m;
+    return grid_graph((int)sqrt(n), seed);
+}
+
+csr_t *make_complete(int n, int m, uint64_t seed){
+    (void)m;
+    return complete_graph(n, seed);
+}
+
+generator_t generators[] = {
+    {"erdos-renyi", random_graph},
+    {"grid", make_grid},
+    {"rmat", rmat_graph},
+    {"complete", make_complete},
+};
+
+#define NB_GENERATORS ((int)(sizeof(generators) / sizeof(generator_t)))
+
+generator_t *find_generator(const char *name){
+    for (int i = 0; i < NB_GENERATORS; i++) {
+        if (strcmp(generators[i].name, name) == 0) return &generators[i];
+    }
+    return NULL;
+}
+
+/*Moteurs de calcul d’arbre couvrant minimal sélectionnables depuis main. Ils ont
+tous le même prototype, les moteurs séquentiels ignorent nb_threads.*/
+
+struct engine {
+    const char *name;
+    edge *(*run)(csr_t *g, int nb_threads, int *nb_chosen);
+};
+
+typedef struct engine engine_t;
+
+edge *run_kruskal(csr_t *g, int nb_threads, int *nb_chosen){
+    (void)nb_threads;
+    return csr_kruskal(g, nb_chosen);
+}
+
+edge *run_boruvka(csr_t *g, int nb_threads, int *nb_chosen){
+    (void)nb_threads;
+    return csr_boruvka(g, nb_chosen);
+}
+
+edge *run_prim(csr_t *g, int nb_threads, int *nb_chosen){
+    (void)nb_threads;
+    return prim(g, nb_chosen);
+}
+
+edge *run_contracting_boruvka(csr_t *g, int nb_threads, int *nb_chosen){
+    (void)nb_threads;
+    return contracting_boruvka(g, nb_chosen);
+}
+
+engine_t engines[] = {
+    {"kruskal", run_kruskal},
+    {"boruvka", run_boruvka},
+    {"parallel-boruvka", parallel_boruvka},
+    {"filter-kruskal", filter_kruskal},
+    {"prim", run_prim},
+    {"contracting-boruvka", run_contracting_boruvka},
+};
+
+#define NB_ENGINES ((int)(sizeof(engines) / sizeof(engine_t)))
+
+engine_t *find_engine(const char *name){
+    for (int i = 0; i < NB_ENGINES; i++) {
+        if (strcmp(engines[i].name, name) == 0) return &engines[i];
+    }
+    return NULL;
+}
+
+double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+
+
+/*Bancs d’essai, lancés par main avec l’option -b. Les paramètres viennent de la ligne
+de commande (avec des valeurs par défaut raisonnables).*/
+
+struct bench_params {
+    int n;
+    int m;
+    uint64_t seed;
+    int nb_threads;
+    int repeats;
+    generator_t *generator;
+};
+
+typedef struct bench_params bench_params_t;
+
+/*fonction next_thread_count qui renvoie le nombre de threads à essayer après t dans les
+bancs d’essai : on double, mais max_threads est toujours la dernière étape*/
+
+int next_thread_count(int t, int max_threads){
+    if (t < max_threads && 2 * t > max_threads) return max_threads;
+    return 2 * t;
+}
+
+void bench_threads(csr_t *g, const char *name, int max_threads){
+    double reference = 0.;
+    for (int t = 1; t <= max_threads; t = next_thread_count(t, max_threads)) {
+        double start = now();
+        int nb_chosen;
+        edge *mst = parallel_boruvka(g, t, &nb_chosen);
+        double elapsed = now() - start;
+        if (t == 1) reference = elapsed;
+        printf("%-8s %2d threads : %8.3f s (accélération %.2f), poids %.6f\n",
+               name, t, elapsed, reference / elapsed, total_weight(mst, nb_chosen));
+        free(mst);
+    }
+}
+
+/*fonction bench_parallel_boruvka qui mesure l’accélération de parallel_boruvka en
+fonction du nombre de threads (de 1 à nb_threads, en doublant, puis nb_threads) sur un graphe aléatoire
+à n sommets et m arêtes, puis sur une grille d’environ n sommets*/
+
+bool bench_parallel_boruvka(bench_params_t *params){
+    csr_t *g = random_graph(params->n, params->m, params->seed);
+    bench_threads(g, "random", params->nb_threads);
+    csr_free(g);
+    int side = (int)sqrt(params->n);
+    g = grid_graph(side, params->seed);
+    bench_threads(g, "grid", params->nb_threads);
+    csr_free(g);
+    return true;
+}
+
+/*fonction bench_sorts qui trie les arêtes d’un même graphe aléatoire avec chacune
+des méthodes de sort_edges*/
+
+bool bench_sorts(bench_params_t *params){
+    csr_t *g = random_graph(params->n, params->m, params->seed);
+    int p;
+    edge *edges = csr_get_edges(g, &p);
+    edge *copy = malloc(p * sizeof(edge));
+    sort_method_t saved = edge_sort;
+    bool ok = true;
+    for (int method = 0; method < NB_SORT_METHODS; method++) {
+        memcpy(copy, edges, p * sizeof(edge));
+        edge_sort = method;
+        double start = now();
+        sort_edges(copy, p);
+        double elapsed = now() - start;
+        bool sorted = true;
+        for (int i = 1; i < p; i++) {
+            if (copy[i - 1].rho > copy[i].rho) sorted = false;
+        }
+        printf("%-10s %d arêtes : %8.3f s%s\n", sort_names[method], p, elapsed,
+               sorted ? "" : " (ERREUR : tableau non trié)");
+        ok = ok && sorted;
+    }
+    edge_sort = saved;
+    free(copy);
+    free(edges);
+    csr_free(g);
+    return ok;
+}
+
+/*fonction bench_union_find qui compare la version récursive (find/merge) et la
+version itérative (find_halving/merge_rank) de union-find sur des suites d’opérations
+défavorables :
+■ binomial : fusions (i, i + 2^k) par k croissant, qui produisent des arbres de hauteur
+log n, puis une recherche par élément en partant des feuilles les plus profondes ;
+■ random : n fusions de paires aléatoires puis n recherches aléatoires ;
+■ interleaved : fusions et recherches alternées, comme dans kruskal ;
+■ chain : fusions naïves (la racine de i est rattachée à celle de i + 1, sans tenir
+compte des tailles ni des rangs) qui produisent un chemin de longueur n, puis une
+recherche depuis son extrémité la plus profonde. C’est ce cas qui fait déborder la pile
+de la version récursive ; chaque suite est donc exécutée dans un processus fils.*/
+
+void run_union_find(partition_t *p, int sequence, bool iterative, uint64_t seed){
+    int n = p->nb_elements;
+    if (sequence == 0) {
+        for (int s = 1; s < n; s *= 2) {
+            for (int i = 0; i + s < n; i += 2 * s) {
+                if (iterative) merge_rank(p, i, i + s);
+                else merge(p, i, i + s);
+            }
+        }
+        for (int i = n - 1; i >= 0; i--) {
+            if (iterative) find_halving(p, i);
+            else find(p, i);
+        }
+    } else if (sequence == 1) {
+        for (int i = 0; i < n; i++) {
+            int x = random_next(&seed) % n;
+            int y = random_next(&seed) % n;
+            if (iterative) merge_rank(p, x, y);
+            else merge(p, x, y);
+        }
+        for (int i = 0; i < n; i++) {
+            int x = random_next(&seed) % n;
+            if (iterative) find_halving(p, x);
+            else find(p, x);
+        }
+    } else if (sequence == 2) {
+        for (int i = 0; i < 4 * n; i++) {
+            int x = random_next(&seed) % n;
+            int y = random_next(&seed) % n;
+            if (iterative) {
+                int rx, ry;
+                find_pair(p, x, y, &rx, &ry);
+                if (rx != ry && i % 4 == 0) link_roots(p, rx, ry);
+            } else {
+                if (find(p, x) != find(p, y) && i % 4 == 0) merge(p, x, y);
+            }
+        }
+    } else {
+        for (int i = 0; i + 1 < n; i++) {
+            int rx = iterative ? find_halving(p, i) : find(p, i);
+            int ry = iterative ? find_halving(p, i + 1) : find(p, i + 1);
+            if (rx == ry) continue;
+            p->arr[rx] = ry;
+            p->nb_sets--;
+        }
+        if (n > 0) {
+            if (iterative) find_halving(p, 0);
+            else find(p, 0);
+        }
+    }
+}
+
+/*fonction run_union_find_isolated qui exécute run_union_find dans un processus fils
+sur une partition de n éléments, et renvoie false si le fils n’a pas terminé normalement
+(débordement de pile de la version récursive, par exemple)*/
+
+struct union_find_result {
+    double elapsed;
+    int nb_sets;
+};
+
+bool run_union_find_isolated(int n, int sequence, bool iterative, uint64_t seed,
+                             struct union_find_result *r){
+    int fds[2];
+    if (pipe(fds) == -1) return false;
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) return false;
+    if (pid == 0) {
+        close(fds[0]);
+        partition_t *p = partition_new(n);
+        double start = now();
+        run_union_find(p, sequence, iterative, seed);
+        r->elapsed = now() - start;
+        r->nb_sets = nb_sets(p);
+        partition_free(p);
+        ssize_t written = write(fds[1], r, sizeof(*r));
+        _exit(written == sizeof(*r) ? 0 : 1);
+    }
+    close(fds[1]);
+    ssize_t nb_read = read(fds[0], r, sizeof(*r));
+    close(fds[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    return nb_read == sizeof(*r) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+bool bench_union_find(bench_params_t *params){
+    const char *names[] = {"binomial", "random", "interleaved", "chain"};
+    for (int sequence = 0; sequence < 4; sequence++) {
+        for (int iterative = 0; iterative < 2; iterative++) {
+            struct union_find_result r;
+            const char *variant = iterative ? "itératif" : "récursif";
+            if (run_union_find_isolated(params->n, sequence, iterative, params->seed, &r)) {
+                printf("%-12s %-10s : %8.3f s (%d ensembles)\n", names[sequence], variant,
+                       r.elapsed, r.nb_sets);
+            } else {
+                printf("%-12s %-10s : échec (débordement de pile ?)\n", names[sequence], variant);
+            }
+        }
+    }
+    return true;
+}
+
+/*fonction bench_components qui compare get_components et parallel_get_components
+(avec 1 à nb_threads threads) sur un graphe aléatoire, et vérifie que les numérotations
+coïncident*/
+
+bool bench_components(bench_params_t *params){
+    csr_t *c = random_graph(params->n, params->m, params->seed);
+    graph_t *g = csr_to_graph(c);
+    csr_free(c);
+    int k;
+    double start = now();
+    int *reference = get_components(g, &k);
+    printf("get_components            : %8.3f s, %d composantes\n", now() - start, k);
+    bool ok = true;
+    for (int t = 1; t <= params->nb_threads; t = next_thread_count(t, params->nb_threads)) {
+        int k_par;
+        start = now();
+        int *arr = parallel_get_components(g, &k_par, t);
+        double elapsed = now() - start;
+        bool same = k_par == k;
+        for (vertex x = 0; x < g->n && same; x++) same = arr[x] == reference[x];
+        printf("parallel_get_components %2d : %8.3f s, %d composantes%s\n", t, elapsed, k_par,
+               same ? "" : " (ERREUR : numérotation différente)");
+        ok = ok && same;
+        free(arr);
+    }
+    free(reference);
+    graph_free(g);
+    return ok;
+}
+
+/*fonction run_isolated qui exécute un moteur dans un processus fils, pour pouvoir
+mesurer son pic de mémoire résidente (graphe compris) indépendamment des autres moteurs.
+Le fils renvoie ses mesures au père par un tube.*/
+
+struct run_result {
+    double elapsed;
+    weight_t weight;
+    int nb_chosen;
+    long max_rss_kb;
+};
+
+bool run_isolated(engine_t *engine, csr_t *g, int nb_threads, struct run_result *r){
+    int fds[2];
+    if (pipe(fds) == -1) return false;
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) return false;
+    if (pid == 0) {
+        close(fds[0]);
+        double start = now();
+        edge *mst = engine->run(g, nb_threads, &r->nb_chosen);
+        r->elapsed = now() - start;
+        r->weight = total_weight(mst, r->nb_chosen);
+        free(mst);
+        ssize_t written = write(fds[1], r, sizeof(*r));
+        _exit(written == sizeof(*r) ? 0 : 1);
+    }
+    close(fds[1]);
+    ssize_t nb_read = read(fds[0], r, sizeof(*r));
+    close(fds[0]);
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    r->max_rss_kb = usage.ru_maxrss;
+    return nb_read == sizeof(*r) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/*fonction bench_all_engines qui exécute repeats fois chaque moteur sur g (chaque fois
+dans un processus fils) et affiche le temps médian, le débit en arêtes par seconde et le
+pic de mémoire résidente. Elle vérifie aussi que tous les moteurs trouvent le même poids
+total que le premier moteur qui aboutit, et renvoie false sinon. Les moteurs en échec
+sont signalés à part, ne sont comparés à rien, et sont comptés dans *nb_failed.*/
+
+#define WEIGHT_TOLERANCE 1e-9
+
+int compare_doubles(const void *a, const void *b){
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+bool bench_all_engines(csr_t *g, const char *family, int nb_threads, int repeats,
+                       int *nb_failed){
+    int m = csr_number_of_edges(g);
+    double *times = malloc(repeats * sizeof(double));
+    weight_t reference = 0.;
+    bool has_reference = false;
+    bool agree = true;
+    for (int i = 0; i < NB_ENGINES; i++) {
+        struct run_result r;
+        long max_rss_kb = 0;
+        bool ok = true;
+        for (int k = 0; k < repeats && ok; k++) {
+            ok = run_isolated(&engines[i], g, nb_threads, &r);
+            times[k] = r.elapsed;
+            if (r.max_rss_kb > max_rss_kb) max_rss_kb = r.max_rss_kb;
+        }
+        if (!ok) {
+            printf("%-11s n = %-9d m = %-10d %-20s échec\n", family, g->n, m, engines[i].name);
+            (*nb_failed)++;
+            continue;
+        }
+        qsort(times, repeats, sizeof(double), compare_doubles);
+        double median = times[repeats / 2];
+        if (!has_reference) {
+            reference = r.weight;
+            has_reference = true;
+        }
+        bool same = fabs(r.weight - reference) <= WEIGHT_TOLERANCE * fabs(reference);
+        agree = agree && same;
+        printf("%-11s n = %-9d m = %-10d %-20s %8.3f s %8.2f Marêtes/s %8.1f Mo  poids %.6f%s\n",
+               family, g->n, m, engines[i].name, median, m / median / 1e6, max_rss_kb / 1024.,
+               r.weight, same ? "" : "  DÉSACCORD");
+    }
+    free(times);
+    return agree;
+}
+
+/*fonction bench_engines qui lance tous les moteurs sur des graphes creux (m = 4n),
+denses (m = n² / 4) et des grilles, de tailles croissantes : le nombre d’arêtes est
+multiplié par 4 à chaque étape, jusqu’à environ params->m*/
+
+bool bench_engines(bench_params_t *params){
+    bool agree = true;
+    int nb_failed = 0;
+    for (int m = params->m / 64 > 1 ? params->m / 64 : 1; m <= params->m; m *= 4) {
+        csr_t *g = random_graph(m / 4 > 2 ? m / 4 : 2, m, params->seed);
+        agree = bench_all_engines(g, "sparse", params->nb_threads, params->repeats, &nb_failed) && agree;
+        csr_free(g);
+        int n = 2 * (int)sqrt(m);
+        g = random_graph(n, m, params->seed);
+        agree = bench_all_engines(g, "dense", params->nb_threads, params->repeats, &nb_failed) && agree;
+        csr_free(g);
+        int side = (int)sqrt(m / 2);
+        g = grid_graph(side > 2 ? side : 2, params->seed);
+        agree = bench_all_engines(g, "grid", params->nb_threads, params->repeats, &nb_failed) && agree;
+        csr_free(g);
+    }
+    if (nb_failed > 0) printf("ERREUR : %d exécution(s) en échec\n", nb_failed);
+    return agree && nb_failed == 0;
+}
+
+/*fonction bench_harness qui génère un graphe avec le générateur choisi (option -g) et
+les paramètres n, m et graine, puis compare tous les moteurs dessus*/
+
+bool bench_harness(bench_params_t *params){
+    csr_t *g = params->generator->make(params->n, params->m, params->seed);
+    if (g == NULL) {
+        fprintf(stderr, "%s : graphe trop grand\n", params->generator->name);
+        return false;
+    }
+    int nb_failed = 0;
+    bool agree = bench_all_engines(g, params->generator->name, params->nb_threads, params->repeats,
+                                   &nb_failed);
+    printf(agree ? "les moteurs qui ont abouti sont d’accord\n"
+                 : "ERREUR : les moteurs ne sont pas d’accord\n");
+    if (nb_failed > 0) printf("ERREUR : %d moteur(s) en échec\n", nb_failed);
+    csr_free(g);
+    return agree && nb_failed == 0;
+}
+
+/*fonction bench_clustering qui balaie dix seuils de coupe sur le dendrogramme d’un
+graphe aléatoire, et compare au recalcul de kruskal pour chaque seuil*/
+
+bool bench_clustering(bench_params_t *params){
+    csr_t *g = params->generator->make(params->n, params->m, params->seed);
+    if (g == NULL) {
+        fprintf(stderr, "%s : graphe trop grand\n", params->generator->name);
+        return false;
+    }
+    double start = now();
+    dendrogram_t *d = single_linkage(g);
+    printf("dendrogramme : %.3f s (%d fusions)\n", now() - start, d->nb_merges);
+    weight_t max_height = d->nb_merges > 0 ? d->merges[d->nb_merges - 1].height : 0.;
+    double cut_time = 0.;
+    double kruskal_time = 0.;
+    for (int i = 1; i <= 10; i++) {
+        weight_t threshold = max_height * i / 10;
+        start = now();
+        int nb_clusters;
+        int *labels = cut_threshold(d, threshold, &nb_clusters);
+        cut_time += now() - start;
+        start = now();
+        int nb_chosen;
+        edge *mst = csr_kruskal(g, &nb_chosen);
+        kruskal_time += now() - start;
+        printf("seuil %.6f : %d classes\n", threshold, nb_clusters);
+        free(mst);
+        free(labels);
+    }
+    printf("coupes : %.3f s, recalculs par kruskal : %.3f s\n", cut_time, kruskal_time);
+    dendrogram_free(d);
+    csr_free(g);
+    return true;
+}
+
+/*fonction bench_sum qui compare la somme naïve et la somme compensée sur params->m
+poids d’ordres de grandeur très différents, et vérifie que parallel_total_weight donne
+le même résultat bit à bit pour 1 à nb_threads threads*/
+
+bool bench_sum(bench_params_t *params){
+    int m = params->m;
+    uint64_t seed = params->seed;
+    edge *edges = malloc(m * sizeof(edge));
+    for (int i = 0; i < m; i++) {
+        edges[i].x = 0;
+        edges[i].y = 0;
+        edges[i].rho = ldexp(random_weight(&seed), (int)(random_next(&seed) % 40) - 20);
+    }
+    long double reference = 0.;
+    weight_t naive = 0.;
+    double start = now();
+    for (int i = 0; i < m; i++) naive += edges[i].rho;
+    double naive_time = now() - start;
+    for (int i = 0; i < m; i++) reference += edges[i].rho;
+    printf("naïve      : %.17g (erreur %.3g) %8.3f s\n", naive,
+           (double)(naive - reference), naive_time);
+    weight_t first = 0.;
+    bool ok = true;
+    for (int t = 1; t <= params->nb_threads; t = next_thread_count(t, params->nb_threads)) {
+        start = now();
+        weight_t sum = parallel_total_weight(edges, m, t);
+        double elapsed = now() - start;
+        if (t == 1) first = sum;
+        bool same = memcmp(&sum, &first, sizeof(weight_t)) == 0;
+        printf("compensée %2d threads : %.17g (erreur %.3g) %8.3f s%s\n", t, sum,
+               (double)(sum - reference), elapsed, same ? "" : "  ERREUR : résultat différent");
+        ok = ok && same;
+    }
+    free(edges);
+    return ok;
+}
+
+/*fonction bench_replay qui insère params->m arêtes aléatoires une par une dans une
+dynamic_mst_t, et compare au recalcul complet par kruskal après chaque insertion. Ce
+recalcul étant quadratique au total, on ne le mesure qu’en dix points de la suite, et on
+en déduit une estimation du coût total (ces points servent aussi à vérifier les poids).*/
+
+bool bench_replay(bench_params_t *params){
+    int n = params->n;
+    int m = params->m;
+    uint64_t seed = params->seed;
+    edge *stream = malloc(m * sizeof(edge));
+    for (int i = 0; i < m; i++) {
+        stream[i].x = random_next(&seed) % n;
+        stream[i].y = random_next(&seed) % n;
+        stream[i].rho = random_weight(&seed);
+    }
+    edge *copy = malloc(m * sizeof(edge));
+    dynamic_mst_t *d = dynamic_mst_new(n);
+    double dynamic_time = 0.;
+    double recompute_time = 0.;
+    int next_checkpoint = m / 10;
+    bool agree = true;
+    for (int i = 0; i < m; i++) {
+        double start = now();
+        dynamic_mst_insert(d, stream[i]);
+        dynamic_time += now() - start;
+        if (i + 1 == next_checkpoint || i + 1 == m) {
+            memcpy(copy, stream, (i + 1) * sizeof(edge));
+            start = now();
+            int nb_chosen;
+            edge *mst = kruskal_edges(n, copy, i + 1, &nb_chosen);
+            double elapsed = now() - start;
+            recompute_time += elapsed * m / 10;
+            weight_t dynamic = dynamic_mst_total_weight(d);
+            weight_t reference = total_weight(mst, nb_chosen);
+            bool same = fabs(dynamic - reference) <= WEIGHT_TOLERANCE * fabs(reference);
+            agree = agree && same;
+            printf("%9d insertions : dynamique %.6f, kruskal %.6f (recalcul %.3f s)%s\n", i + 1,
+                   dynamic, reference, elapsed, same ? "" : "  ERREUR : poids différents");
+            free(mst);
+            next_checkpoint += m / 10;
+        }
+    }
+    printf("dynamique : %.3f s au total (%.3f µs par insertion)\n", dynamic_time,
+           1e6 * dynamic_time / m);
+    printf("recalcul à chaque insertion : environ %.1f s\n", recompute_time);
+    dynamic_mst_free(d);
+    free(copy);
+    free(stream);
+    return agree;
+}
+
+/*fonction bench_minimal_edges qui compare les versions scalaire et AVX2 de
+csr_get_minimal_edges sur un graphe aléatoire dont les sommets sont répartis
+aléatoirement en n / 8 composantes, et vérifie que les résultats coïncident*/
+
+bool bench_minimal_edges(bench_params_t *params){
+    csr_t *g = random_graph(params->n, params->m, params->seed);
+    int nb_components = params->n / 8 > 0 ? params->n / 8 : 1;
+    int *components = malloc(g->n * sizeof(int));
+    uint64_t seed = params->seed;
+    for (vertex x = 0; x < g->n; x++) components[x] = random_next(&seed) % nb_components;
+    if (!has_avx2()) printf("(AVX2 indisponible : la version vectorisée est la version scalaire)\n");
+    double start = now();
+    edge *scalar = csr_get_minimal_edges_scalar(g, components, nb_components);
+    double scalar_time = now() - start;
+    start = now();
+    edge *vectorised = csr_get_minimal_edges_avx2(g, components, nb_components);
+    double vectorised_time = now() - start;
+    bool same = true;
+    for (int c = 0; c < nb_components; c++) {
+        same = same && scalar[c].x == vectorised[c].x && scalar[c].y == vectorised[c].y;
+    }
+    printf("scalaire : %8.3f s\nAVX2     : %8.3f s (accélération %.2f)%s\n", scalar_time,
+           vectorised_time, scalar_time / vectorised_time,
+           same ? "" : "\nERREUR : résultats différents");
+    free(scalar);
+    free(vectorised);
+    free(components);
+    csr_free(g);
+    return same;
+}
+
+/*Bancs d’essai sélectionnables depuis main : chacun renvoie false si l’une de ses
+vérifications a échoué, et le programme se termine alors avec un code non nul.*/
+
+struct benchmark {
+    const char *name;
+    bool (*run)(bench_params_t *params);
+};
+
+typedef struct benchmark benchmark_t;
+
+benchmark_t benchmarks[] = {
+    {"parallel-boruvka", bench_parallel_boruvka},
+    {"sort", bench_sorts},
+    {"union-find", bench_union_find},
+    {"components", bench_components},
+    {"engines", bench_engines},
+    {"replay", bench_replay},
+    {"minimal-edges", bench_minimal_edges},
+    {"harness", bench_harness},
+    {"clustering", bench_clustering},
+    {"sum", bench_sum},
+};
+
+#define NB_BENCHMARKS ((int)(sizeof(benchmarks) / sizeof(benchmark_t)))
+
+benchmark_t *find_benchmark(const char *name){
+    for (int i = 0; i < NB_BENCHMARKS; i++) {
+        if (strcmp(benchmarks[i].name, name) == 0) return &benchmarks[i];
+    }
+    return NULL;
+}
+
+void print_forest(int n, edge *edges, int nb_chosen){
+    bool connected = (nb_chosen == n - 1);
+    if (connected) {
+        printf("Minimum Spanning Tree:\n");
+    } else {
+        printf("Minimum Spanning Forest (%d trees):\n", n - nb_chosen);
+    }
+    printf("Total weight %.3f\n", total_weight(edges, nb_chosen));
+    print_edge_array(edges, nb_chosen);
+}
+
+void usage(const char *prog){
+    fprintf(stderr, "usage : %s [-a moteur] [-t threads] [-s tri] [-f graphe.bin] < graphe\n", prog);
+    fprintf(stderr, "        %s -c graphe.bin < graphe\n", prog);
+    fprintf(stderr, "        %s -e aretes.bin < graphe\n", prog);
+    fprintf(stderr, "        %s -x aretes.bin [-M mémoire en Mo]\n", prog);
+    fprintf(stderr, "        %s -b banc [-g générateur] [-n sommets] [-m arêtes] [-r graine] [-R répétitions] [-t threads]\n", prog);
+    fprintf(stderr, "moteurs :");
+    for (int i = 0; i < NB_ENGINES; i++) fprintf(stderr, " %s", engines[i].name);
+    fprintf(stderr, "\ntris :");
+    for (int i = 0; i < NB_SORT_METHODS; i++) fprintf(stderr, " %s", sort_names[i]);
+    fprintf(stderr, "\ngénérateurs :");
+    for (int i = 0; i < NB_GENERATORS; i++) fprintf(stderr, " %s", generators[i].name);
+    fprintf(stderr, "\nbancs :");
+    for (int i = 0; i < NB_BENCHMARKS; i++) fprintf(stderr, " %s", benchmarks[i].name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[]){
+    const char *engine_name = "kruskal";
+    const char *bench_name = NULL;
+    const char *input_path = NULL;
+    const char *output_path = NULL;
+    const char *edges_output_path = NULL;
+    const char *edges_input_path = NULL;
+    size_t memory_budget = 256 << 20;
+    bench_params_t params = {.n = 1 << 20, .m = 1 << 22, .seed = 1, .nb_threads = 1, .repeats = 3,
+                             .generator = &generators[0]};
+    int opt;
+    while ((opt = getopt(argc, argv, "a:t:s:f:c:e:x:M:b:g:n:m:r:R:")) != -1) {
+        switch (opt) {
+        case 'a':
+            engine_name = optarg;
+            break;
+        case 't':
+            params.nb_threads = atoi(optarg);
+            break;
+        case 's':
+            edge_sort = NB_SORT_METHODS;
+            for (int i = 0; i < NB_SORT_METHODS; i++) {
+                if (strcmp(sort_names[i], optarg) == 0) edge_sort = i;
+            }
+            if (edge_sort == NB_SORT_METHODS) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'f':
+            input_path = optarg;
+            break;
+        case 'c':
+            output_path = optarg;
+            break;
+        case 'e':
+            edges_output_path = optarg;
+            break;
+        case 'x':
+            edges_input_path = optarg;
+            break;
+        case 'M': {
+            char *end;
+            errno = 0;
+            unsigned long long megabytes = strtoull(optarg, &end, 10);
+            if (errno != 0 || end == optarg || *end != '\0' || megabytes == 0 ||
+                megabytes > SIZE_MAX >> 20) {
+                fprintf(stderr, "%s : budget mémoire invalide\n", optarg);
+                return 1;
+            }
+            memory_budget = (size_t)megabytes << 20;
+            break;
+        }
+        case 'b':
+            bench_name = optarg;
+            break;
+        case 'g':
+            params.generator = find_generator(optarg);
+            if (params.generator == NULL) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'R':
+            params.repeats = atoi(optarg);
+            break;
+        case 'n':
+            params.n = atoi(optarg);
+            break;
+        case 'm':
+            params.m = atoi(optarg);
+            break;
+        case 'r':
+            params.seed = strtoull(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (params.nb_threads < 1) params.nb_threads = 1;
+    if (params.repeats < 1) params.repeats = 1;
+
+    if (bench_name != NULL) {
+        benchmark_t *b = find_benchmark(bench_name);
+        if (b == NULL) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (params.n < 2 || params.m < 0) {
+            fprintf(stderr, "les bancs d’essai demandent au moins 2 sommets et m >= 0\n");
+            return 1;
+        }
+        return b->run(&params) ? 0 : 1;
+    }
+
+    if (output_path != NULL || edges_output_path != NULL) {
+        csr_t *g = csr_read_graph(stdin);
+        bool ok = true;
+        if (output_path != NULL && !csr_write(g, output_path)) {
+            perror(output_path);
+            ok = false;
+        }
+        if (edges_output_path != NULL && !write_edge_file(g, edges_output_path)) {
+            perror(edges_output_path);
+            ok = false;
+        }
+        csr_free(g);
+        return ok ? 0 : 1;
+    }
+
+    if (edges_input_path != NULL) {
+        int n;
+        int nb_chosen;
+        edge *edges = external_kruskal(edges_input_path, memory_budget, &n, &nb_chosen);
+        if (edges == NULL) {
+            fprintf(stderr, "%s : fichier d’arêtes invalide\n", edges_input_path);
+            return 1;
+        }
+        print_forest(n, edges, nb_chosen);
+        free(edges);
+        return 0;
+    }
+
+    engine_t *engine = find_engine(engine_name);
+    if (engine == NULL) {
+        usage(argv[0]);
+        return 1;
+    }
+    csr_t *g;
+    if (input_path != NULL) {
+        g = csr_map(input_path);
+        if (g == NULL) {
+            fprintf(stderr, "%s : fichier de graphe invalide\n", input_path);
+            return 1;
+        }
+    } else {
+        g = csr_read_graph(stdin);
+    }
+    int nb_chosen;
+    edge *edges = engine->run(g, params.nb_threads, &nb_chosen);
+    print_forest(g->n, edges, nb_chosen);
+    free(edges);
+    csr_free(g);
+}
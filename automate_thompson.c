@@ -3,18 +3,29 @@
 #include <string.h>
 #include <stdio.h>
 #include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
 #define EPS 256
 #define ALL 257
 #define MATCH 258
+// un état de champ c = SAVE + k enregistre la position courante dans la case k des captures
+#define SAVE 259
 
-#define MAX_LINE_LENGTH 1024
+#define READ_BUFFER_SIZE (1 << 20)
+#define OUTPUT_BUFFER_SIZE (1 << 16)
+#define CHUNK_SIZE (4 << 20)
 struct state {
     int c;
     struct state *out1;
     struct state *out2;
-    int last_set;
+    int index;
 };
 
 typedef struct state state_t;
@@ -27,6 +38,55 @@ struct nfa {
 
 typedef struct nfa nfa_t;
 
+/*Les états sont alloués dans une arène (un seul bloc, libéré d’un coup), d’au plus deux
+états par caractère de l’expression.*/
+
+struct arena {
+    int length;
+    int capacity;
+    state_t *states;
+};
+
+typedef struct arena arena_t;
+
+/*Forme compilée de l’automate, seule utilisée à l’exécution : les états sont rangés de
+manière contiguë et numérotés de 0 à n - 1, out1 et out2 sont des indices (-1 pour
+l’absence de transition). Un programme peut regrouper plusieurs motifs (voir
+compile_patterns) : pattern[x] est le numéro du motif dont x est l’état final, -1 si x
+n’est pas final ; le champ final n’a de sens que s’il n’y a qu’un motif. Les états SAVE
+deviennent des états EPS (les autres moteurs les traversent donc sans rien faire), et
+save[x] vaut k si x était l’état SAVE + k, -1 sinon ; nb_slots est le nombre de cases
+de capture. Les octets qui ne se distinguent pas (aucun état ne lit l’un sans l’autre)
+forment une même classe : byte_class[b] est la classe de l’octet b, entre 0 et
+nb_classes - 1. Un programme compilé est alloué en un seul bloc (states, pattern et save
+pointent juste après la structure) ; un programme chargé par program_map pointe dans
+la projection map (voir program_write).*/
+
+struct flat_state {
+    int c;
+    int out1;
+    int out2;
+};
+
+typedef struct flat_state flat_state_t;
+
+struct program {
+    int n;
+    int start;
+    int final;
+    int nb_patterns;
+    int *pattern;
+    int nb_slots;
+    int *save;
+    int nb_classes;
+    unsigned char byte_class[256];
+    flat_state_t *states;
+    void *map;
+    size_t map_size;
+};
+
+typedef struct program program_t;
+
 struct stack {
     int length;
     int capacity;
@@ -35,31 +95,52 @@ struct stack {
 
 typedef struct stack stack_t;
 
+/*L’appartenance à un ensemble est marquée dans son propre tableau marks (indexé par le
+champ index des états) et non dans les états eux-mêmes : plusieurs threads peuvent ainsi
+simuler le même automate simultanément. L’identifiant augmente d’environ un par octet lu
+sur toute l’entrée : il est sur 64 bits pour ne jamais revenir à une valeur déjà présente
+dans marks, même sur des fichiers de plusieurs gigaoctets.*/
+
 struct set {
     int length;
-    int id;
-    state_t **states;
+    uint64_t id;
+    int *states;
+    uint64_t *marks;
 };
 
 typedef struct set set_t;
 
-/*fonction new_state renvoyant un pointeur vers un nouvel état (alloué sur le tas).
-Comme dit plus haut, on initialisera last_set à -1.*/
+arena_t *arena_new(int capacity){
+    arena_t *arena = malloc(sizeof(arena_t));
+    arena->length = 0;
+    arena->capacity = capacity;
+    arena->states = malloc(capacity * sizeof(state_t));
+    return arena;
+}
+
+void arena_free(arena_t *arena){
+    free(arena->states);
+    free(arena);
+}
+
+/*fonction new_state renvoyant un pointeur vers un nouvel état (alloué dans l’arène).
+L’index vaut -1 tant que l’automate n’a pas été numéroté (voir number_states).*/
 
-state_t *new_state(int c, state_t *out1, state_t *out2){
-    state_t* new_st = malloc(sizeof(state_t));
+state_t *new_state(arena_t *arena, int c, state_t *out1, state_t *out2){
+    assert(arena->length < arena->capacity);
+    state_t* new_st = &arena->states[arena->length++];
     new_st->c = c;
     new_st->out1 = out1;
     new_st->out2 = out2;
-    new_st->last_set = -1;
+    new_st->index = -1;
     return new_st;
 }
 
 /*fonction character qui renvoie un nfa_t reconnaissant le caractère donné. Attention, on renvoie bien un nfa_t, par valeur, et pas un nfa_t*/
 
-nfa_t character(char c){
-    state_t* final = new_state(MATCH,NULL,NULL);
-    state_t* initial = new_state(c,final,NULL);
+nfa_t character(arena_t *arena, char c){
+    state_t* final = new_state(arena,MATCH,NULL,NULL);
+    state_t* initial = new_state(arena,c,final,NULL);
     nfa_t automate;
     automate.final = final;
     automate.start = initial;
@@ -71,10 +152,10 @@ nfa_t character(char c){
 1. On utilisera le même automate que pour character, sauf que le champ c de l’état initial
 sera mis à la valeur ALL*/
 
-nfa_t all(void){
+nfa_t all(arena_t *arena){
     nfa_t automate;
-    state_t* final = new_state(ALL,NULL,NULL);
-    state_t* initial = new_state(MATCH,final,NULL);
+    state_t* final = new_state(arena,MATCH,NULL,NULL);
+    state_t* initial = new_state(arena,ALL,final,NULL);
     automate.final = final;
     automate.start = initial;
     automate.n = 2;
@@ -95,10 +176,10 @@ nfa_t concat(nfa_t a, nfa_t b){
     return a;
 }
 
-nfa_t alternative(nfa_t a, nfa_t b){
+nfa_t alternative(arena_t *arena, nfa_t a, nfa_t b){
     nfa_t automate;
-    state_t* start = new_state(EPS,a.start,b.start);
-    state_t* final = new_state(MATCH,NULL,NULL);
+    state_t* start = new_state(arena,EPS,a.start,b.start);
+    state_t* final = new_state(arena,MATCH,NULL,NULL);
     a.final->c = EPS;
     b.final->c = EPS;
     a.final->out1 = final;
@@ -109,23 +190,27 @@ nfa_t alternative(nfa_t a, nfa_t b){
     return automate;
 }
 
-nfa_t star(nfa_t a){
+/*Dans les états EPS, out1 est prioritaire sur out2 (cela ne compte que pour les
+captures, voir pike) : star et maybe essaient d’abord de lire a, ce qui les rend
+gloutons, et alternative préfère a à b.*/
+
+nfa_t star(arena_t *arena, nfa_t a){
     nfa_t automate;
-    state_t* start = new_state(EPS,a.start,NULL);
-    state_t* final =  new_state(MATCH,NULL,NULL);
+    state_t* start = new_state(arena,EPS,a.start,NULL);
+    state_t* final =  new_state(arena,MATCH,NULL,NULL);
     start->out2 = final;
     a.final->c = EPS;
     start->out1 = a.start;
-    a.final->out1 = final;
-    a.final->out2 = a.start;
+    a.final->out1 = a.start;
+    a.final->out2 = final;
     automate.start = start;
     automate.final = final;
     automate.n = a.n + 2;
     return automate;
 }
 
-nfa_t maybe(nfa_t a){
-    state_t* start = new_state(EPS,a.start,a.final);
+nfa_t maybe(arena_t *arena, nfa_t a){
+    state_t* start = new_state(arena,EPS,a.start,a.final);
     nfa_t automate;
     automate.start = start;
     automate.final = a.final;
@@ -133,38 +218,103 @@ nfa_t maybe(nfa_t a){
     return automate;
 }
 
-/*Cette fonction renverra true si la lecture du mot s depuis l’état pointé par state nous
-amène dans un état final, false sinon. On considérera que le mot s’arrête au premier
-caractère nul ou '\n' rencontré, exclu*/
+/*fonction group qui entoure a de deux états SAVE enregistrant le début et la fin de ce
+qui est lu par a dans les cases 2k et 2k + 1*/
 
-bool backtrack(state_t *state, char *s){
-    if (state == NULL) return false;
-    if (state->c == EPS) {
-        return backtrack(state->out1, s) || backtrack(state->out2, s);
-    }
-    if (s[0] == '\0' || s[0] == '\n') return state->c == MATCH;
-    if (s[0] == state->c || state->c == ALL) {
-        return backtrack(state->out1, &s[1]);
-    }
-    return false;
+nfa_t group(arena_t *arena, nfa_t a, int k){
+    nfa_t automate;
+    state_t* start = new_state(arena,SAVE + 2 * k,a.start,NULL);
+    state_t* final = new_state(arena,MATCH,NULL,NULL);
+    a.final->c = SAVE + 2 * k + 1;
+    a.final->out1 = final;
+    automate.start = start;
+    automate.final = final;
+    automate.n = a.n + 2;
+    return automate;
 }
 
-bool accept_backtrack(nfa_t a, char *s){
-    return backtrack(a.start, s);
+/*Couche d’entrée commune à tous les moteurs : un moteur est une fonction match(ctx,
+line, len) qui dit si la ligne (sans son '\n') est reconnue. Les fichiers ordinaires
+sont projetés en mémoire par mmap et les lignes sont passées au moteur directement dans
+la projection, sans copie ; les tubes et l’entrée standard sont lus par gros blocs dans
+un tampon qui grandit si une ligne ne tient pas dedans. Les lignes n’ont donc pas de
+longueur maximale. Les lignes reconnues sont écrites par un seul fwrite (tamponné).*/
+
+typedef bool (*line_matcher_t)(void *ctx, const char *line, size_t len);
+
+/*Si emit n’est pas NULL, c’est emit(ctx, line, len, out) qui écrit la sortie
+correspondant à une ligne reconnue (numéros des motifs reconnus, parties reconnues...)
+au lieu de la ligne elle-même.*/
+
+typedef void (*line_emit_t)(void *ctx, const char *line, size_t len, FILE *out);
+
+/*fonction scan_lines qui traite les lignes complètes de buf et renvoie le nombre
+d’octets consommés ; si last est vrai, la dernière ligne peut ne pas se terminer par
+'\n' (on l’ajoute alors en sortie).*/
+
+size_t scan_lines(const char *buf, size_t size, bool last,
+                  line_matcher_t match, line_emit_t emit, void *ctx, FILE *out){
+    size_t pos = 0;
+    while (pos < size) {
+        const char *eol = memchr(buf + pos, '\n', size - pos);
+        if (eol == NULL) {
+            if (!last) break;
+            if (!match(ctx, buf + pos, size - pos)) return size;
+            if (emit != NULL) {
+                emit(ctx, buf + pos, size - pos, out);
+            } else {
+                fwrite(buf + pos, 1, size - pos, out);
+                putc('\n', out);
+            }
+            return size;
+        }
+        size_t len = eol - (buf + pos);
+        if (match(ctx, buf + pos, len)) {
+            if (emit != NULL) emit(ctx, buf + pos, len, out);
+            else fwrite(buf + pos, 1, len + 1, out);
+        }
+        pos += len + 1;
+    }
+    return pos;
 }
 
-void match_stream_backtrack(nfa_t a, FILE *in){
-    char *line = malloc((MAX_LINE_LENGTH + 1) * sizeof(char));
+void match_lines(FILE *in, line_matcher_t match, line_emit_t emit, void *ctx){
+    int fd = fileno(in);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            scan_lines(map, st.st_size, true, match, emit, ctx, stdout);
+            munmap(map, st.st_size);
+            fflush(stdout);
+            return;
+        }
+    }
+    size_t capacity = READ_BUFFER_SIZE;
+    size_t length = 0;
+    char *buf = malloc(capacity);
     while (true) {
-        if (fgets(line, MAX_LINE_LENGTH, in) == NULL) break;
-        if (accept_backtrack(a, line)) {
-            printf("%s", line);
+        if (length == capacity) {
+            capacity *= 2;
+            buf = realloc(buf, capacity);
         }
+        ssize_t r = read(fd, buf + length, capacity - length);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        // on ne relance le découpage que si le bloc lu termine au moins une ligne
+        bool has_line = memchr(buf + length, '\n', r) != NULL;
+        length += r;
+        if (!has_line) continue;
+        size_t done = scan_lines(buf, length, false, match, emit, ctx, stdout);
+        memmove(buf, buf + done, length - done);
+        length -= done;
     }
-    free(line);
+    scan_lines(buf, length, true, match, emit, ctx, stdout);
+    free(buf);
+    fflush(stdout);
 }
 
-
 stack_t *stack_new(int capacity){
     stack_t *s = malloc(sizeof(stack_t));
     s->data = malloc(capacity * sizeof(nfa_t));
@@ -191,8 +341,36 @@ void push(stack_t *s, nfa_t a){
     s->length++;
 }
 
-nfa_t build(char *regex){
+/*fonction number_states qui numérote de 0 à n - 1 les états de l’automate (champ index)*/
+
+void number_states(nfa_t a){
+    state_t **stack = malloc(a.n * sizeof(state_t*));
+    int length = 0;
+    int next = 0;
+    a.start->index = next++;
+    stack[length++] = a.start;
+    while (length > 0) {
+        state_t *q = stack[--length];
+        state_t *succ[2] = {q->out1, q->out2};
+        for (int k = 0; k < 2; k++) {
+            if (succ[k] != NULL && succ[k]->index < 0) {
+                succ[k]->index = next++;
+                stack[length++] = succ[k];
+            }
+        }
+    }
+    assert(next == a.n);
+    free(stack);
+}
+
+/*Syntaxe postfixe : @ concaténation, | alternative, * étoile, ? option, . n’importe quel
+caractère, \# groupe de capture (numérotés à partir de 1 dans l’ordre des \#). Un \ suivi
+d’un autre caractère désigne ce caractère lui-même (\@ pour @, \\ pour \, etc.), et tout
+autre caractère, # compris, se désigne lui-même.*/
+
+nfa_t build(arena_t *arena, char *regex){
     int size = strlen(regex);
+    int nb_groups = 0;
     stack_t* s = stack_new(size);
     for (int i = 0; i < size; i++){
         char c = regex[i];
@@ -208,43 +386,590 @@ nfa_t build(char *regex){
         case '|':
             b = pop(s);
             a = pop(s);
-            push(s,alternative(a,b));
+            push(s,alternative(arena,a,b));
             break;
         case '*':
             a = pop(s);
-            push(s,star(a));
+            push(s,star(arena,a));
             break;
         case '?':
             a = pop(s);
-            push(s,maybe(a));
+            push(s,maybe(arena,a));
             break;
         case '.':
-            push(s,all());
+            push(s,all(arena));
+            break;
+        case '\\':
+            if (i + 1 < size && regex[i + 1] == '#') {
+                i++;
+                a = pop(s);
+                push(s,group(arena,a,++nb_groups));
+            } else {
+                if (i + 1 < size) i++;
+                push(s,character(arena,regex[i]));
+            }
             break;
         default:
-            push(s,character(s));
+            push(s,character(arena,c));
             break;
         }
     }
-    assert(s->length = 1);
+    assert(s->length == 1);
     nfa_t result = pop(s);
     stack_free(s);
     return result;
 
 }
 
+/*fonction compute_byte_classes : chaque état non ε lit un seul octet (ou tous, pour ALL),
+donc deux octets sont équivalents s’ils sont égaux ou si aucun état ne lit ni l’un ni
+l’autre*/
+
+void compute_byte_classes(program_t *p){
+    bool used[256] = {false};
+    for (int i = 0; i < p->n; i++) {
+        int c = p->states[i].c;
+        if (c != EPS && c != ALL && c != MATCH) used[(unsigned char)c] = true;
+    }
+    int other = -1;
+    p->nb_classes = 0;
+    for (int b = 0; b < 256; b++) {
+        if (used[b]) {
+            p->byte_class[b] = p->nb_classes++;
+        } else {
+            if (other < 0) other = p->nb_classes++;
+            p->byte_class[b] = other;
+        }
+    }
+}
+
+/*fonction compile qui numérote les états de a (tous alloués dans arena) dans l’ordre d’un
+parcours en profondeur et les recopie dans un program_t*/
+
+program_t *compile(arena_t *arena, nfa_t a){
+    assert(arena->length == a.n);
+    number_states(a);
+    program_t *p = malloc(sizeof(program_t) + a.n * (sizeof(flat_state_t) + 2 * sizeof(int)));
+    p->n = a.n;
+    p->start = a.start->index;
+    p->final = a.final->index;
+    p->nb_patterns = 1;
+    p->states = (flat_state_t*)(p + 1);
+    p->pattern = (int*)&p->states[a.n];
+    p->nb_slots = 0;
+    p->save = p->pattern + a.n;
+    p->map = NULL;
+    p->map_size = 0;
+    for (int i = 0; i < arena->length; i++) {
+        state_t *q = &arena->states[i];
+        flat_state_t *f = &p->states[q->index];
+        f->c = q->c >= SAVE ? EPS : q->c;
+        f->out1 = q->out1 == NULL ? -1 : q->out1->index;
+        f->out2 = q->out2 == NULL ? -1 : q->out2->index;
+        p->pattern[q->index] = -1;
+        p->save[q->index] = q->c >= SAVE ? q->c - SAVE : -1;
+        if (q->c >= SAVE && q->c - SAVE >= p->nb_slots) p->nb_slots = q->c - SAVE + 1;
+    }
+    p->pattern[p->final] = 0;
+    compute_byte_classes(p);
+    return p;
+}
+
+void program_free(program_t *p){
+    if (p->map != NULL) munmap(p->map, p->map_size);
+    free(p);
+}
+
+/*fonction compile_regex ; l’expression entière forme le groupe 0 (position de l’occurrence
+reconnue)*/
+
+program_t *compile_regex(char *regex){
+    arena_t *arena = arena_new(2 * strlen(regex) + 2);
+    program_t *p = compile(arena, group(arena, build(arena, regex), 0));
+    arena_free(arena);
+    return p;
+}
+
+/*fonction compile_patterns qui regroupe les nb automates des expressions regexes en un
+seul programme : une chaîne de nb - 1 états ε dont chacun part vers le départ d’un motif
+sert d’état initial commun, et l’état final du motif k est marqué par pattern = k. Comme
+dans compile_regex, chaque motif entier forme le groupe 0, si bien que tout programme a au
+moins les deux cases de capture de l’occurrence.*/
+
+program_t *compile_patterns(char **regexes, int nb){
+    assert(nb > 0);
+    int capacity = nb - 1;
+    for (int k = 0; k < nb; k++) capacity += 2 * strlen(regexes[k]) + 2;
+    arena_t *arena = arena_new(capacity);
+    nfa_t *a = malloc(nb * sizeof(nfa_t));
+    int n = nb - 1;
+    for (int k = 0; k < nb; k++) {
+        a[k] = group(arena, build(arena, regexes[k]), 0);
+        n += a[k].n;
+    }
+    state_t *start = a[nb - 1].start;
+    for (int k = nb - 2; k >= 0; k--) {
+        start = new_state(arena, EPS, a[k].start, start);
+    }
+    nfa_t all_patterns = {start, a[0].final, n};
+    program_t *p = compile(arena, all_patterns);
+    p->nb_patterns = nb;
+    for (int k = 0; k < nb; k++) {
+        p->pattern[a[k].final->index] = k;
+    }
+    free(a);
+    arena_free(arena);
+    return p;
+}
+
+/*Format binaire d’un programme compilé, écrit par program_write et relu sans copie par
+program_map (projection en mémoire). Dans l’ordre, alignés sur 8 octets :
+■ un en-tête program_header (magic, ordre des octets, tailles) ;
+■ la clé (l’expression, ou les motifs suivis chacun de '\n' pour compile_patterns), qui
+permet de vérifier que le fichier correspond bien à ce qu’on veut compiler ;
+■ le tableau states (n flat_state_t), puis pattern et save (n int chacun).
+Les classes d’octets sont dans l’en-tête. Le format dépend de la machine (ordre des
+octets, taille des int), ce que l’en-tête permet de détecter.*/
+
+#define PROGRAM_MAGIC "THOMPSON"
+#define PROGRAM_VERSION 1
+#define BYTE_ORDER_MARK 0x01020304u
+
+struct program_header {
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t state_size;
+    int32_t n;
+    int32_t start;
+    int32_t final;
+    int32_t nb_patterns;
+    int32_t nb_slots;
+    int32_t nb_classes;
+    uint32_t key_length;
+    unsigned char byte_class[256];
+};
+
+size_t align8(size_t x){
+    return (x + 7) & ~(size_t)7;
+}
+
+/*fonction program_write qui renvoie 0 en cas de succès, -1 sinon (errno est alors
+positionné) ; le fichier est écrit sous un nom temporaire puis renommé, pour qu’un lecteur
+concurrent ne voie jamais de fichier partiel*/
+
+int program_write(const program_t *p, const char *key, const char *path){
+    struct program_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PROGRAM_MAGIC, 8);
+    h.byte_order = BYTE_ORDER_MARK;
+    h.version = PROGRAM_VERSION;
+    h.state_size = sizeof(flat_state_t);
+    h.n = p->n;
+    h.start = p->start;
+    h.final = p->final;
+    h.nb_patterns = p->nb_patterns;
+    h.nb_slots = p->nb_slots;
+    h.nb_classes = p->nb_classes;
+    h.key_length = strlen(key);
+    memcpy(h.byte_class, p->byte_class, 256);
+    size_t tmp_length = strlen(path) + 16;
+    char *tmp = malloc(tmp_length);
+    snprintf(tmp, tmp_length, "%s.%d", path, (int)getpid());
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL) {
+        free(tmp);
+        return -1;
+    }
+    static const char zeros[8] = {0};
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    ok = ok && fwrite(zeros, 1, align8(sizeof(h)) - sizeof(h), f) == align8(sizeof(h)) - sizeof(h);
+    ok = ok && fwrite(key, 1, h.key_length, f) == h.key_length;
+    ok = ok && fwrite(zeros, 1, align8(h.key_length) - h.key_length, f) == align8(h.key_length) - h.key_length;
+    ok = ok && fwrite(p->states, sizeof(flat_state_t), p->n, f) == (size_t)p->n;
+    ok = ok && fwrite(p->pattern, sizeof(int), p->n, f) == (size_t)p->n;
+    ok = ok && fwrite(p->save, sizeof(int), p->n, f) == (size_t)p->n;
+    ok = (fclose(f) == 0) && ok;
+    if (ok) ok = rename(tmp, path) == 0;
+    if (!ok) unlink(tmp);
+    free(tmp);
+    return ok ? 0 : -1;
+}
+
+/*fonction program_valid qui vérifie que les indices d’un programme relu sont dans les
+bornes, pour qu’un fichier corrompu ne puisse pas faire sortir les moteurs des tableaux*/
+
+bool program_valid(const program_t *p){
+    if (p->start < 0 || p->start >= p->n || p->final < 0 || p->final >= p->n) return false;
+    // pike_emit_only lit toujours les cases 0 et 1, et les groupes vont par paires
+    if (p->nb_patterns < 1 || p->nb_slots < 2 || p->nb_slots % 2 != 0 || p->nb_classes < 1 ||
+        p->nb_classes > 256) {
+        return false;
+    }
+    for (int b = 0; b < 256; b++) {
+        if (p->byte_class[b] >= p->nb_classes) return false;
+    }
+    for (int i = 0; i < p->n; i++) {
+        const flat_state_t *f = &p->states[i];
+        if (f->c < -128 || (f->c > 255 && f->c != EPS && f->c != ALL && f->c != MATCH)) return false;
+        if (f->out1 < -1 || f->out1 >= p->n || f->out2 < -1 || f->out2 >= p->n) return false;
+        if (p->pattern[i] < -1 || p->pattern[i] >= p->nb_patterns) return false;
+        if (p->save[i] < -1 || p->save[i] >= p->nb_slots) return false;
+    }
+    return true;
+}
+
+/*fonction program_map qui renvoie le programme stocké dans path, ou NULL si le fichier
+n’existe pas, n’est pas valide, ou a été compilé pour une autre clé*/
+
+program_t *program_map(const char *path, const char *key){
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct program_header)) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+    const struct program_header *h = map;
+    size_t key_length = strlen(key);
+    size_t key_offset = align8(sizeof(struct program_header));
+    size_t states_offset = key_offset + align8(key_length);
+    bool ok = memcmp(h->magic, PROGRAM_MAGIC, 8) == 0 && h->byte_order == BYTE_ORDER_MARK &&
+              h->version == PROGRAM_VERSION && h->state_size == sizeof(flat_state_t) &&
+              h->n > 0 && h->key_length == key_length &&
+              (size_t)st.st_size == states_offset + (size_t)h->n * (sizeof(flat_state_t) + 2 * sizeof(int)) &&
+              memcmp((const char*)map + key_offset, key, key_length) == 0;
+    if (!ok) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    program_t *p = malloc(sizeof(program_t));
+    p->n = h->n;
+    p->start = h->start;
+    p->final = h->final;
+    p->nb_patterns = h->nb_patterns;
+    p->nb_slots = h->nb_slots;
+    p->nb_classes = h->nb_classes;
+    memcpy(p->byte_class, h->byte_class, 256);
+    p->states = (flat_state_t*)((char*)map + states_offset);
+    p->pattern = (int*)&p->states[p->n];
+    p->save = p->pattern + p->n;
+    p->map = map;
+    p->map_size = st.st_size;
+    if (!program_valid(p)) {
+        program_free(p);
+        return NULL;
+    }
+    return p;
+}
+
+/*Cache LRU des programmes compilés, indexé par l’expression, pour les utilisateurs qui
+compilent souvent les mêmes motifs. regex_cache_acquire renvoie le programme (compilé au
+besoin) et le protège ; regex_cache_release le libère. Au-delà de capacity entrées, on
+supprime les moins récemment utilisées parmi celles qui ne sont pas protégées. Le cache
+peut être partagé entre threads.*/
+
+#define CACHE_HASH_SIZE 1024
+
+struct cache_entry {
+    char *regex;
+    program_t *p;
+    int refs;
+    struct cache_entry *prev;
+    struct cache_entry *next;
+    struct cache_entry *hash_next;
+};
+
+struct regex_cache {
+    int capacity;
+    int length;
+    struct cache_entry *table[CACHE_HASH_SIZE];
+    struct cache_entry *head;
+    struct cache_entry *tail;
+    pthread_mutex_t lock;
+};
+
+typedef struct regex_cache regex_cache_t;
+
+regex_cache_t *regex_cache_new(int capacity){
+    regex_cache_t *c = calloc(1, sizeof(regex_cache_t));
+    c->capacity = capacity;
+    pthread_mutex_init(&c->lock, NULL);
+    return c;
+}
+
+unsigned hash_string(const char *s){
+    unsigned hash = 2166136261u;
+    for (; *s != '\0'; s++) hash = (hash ^ (unsigned char)*s) * 16777619u;
+    return hash;
+}
+
+void cache_unlink(regex_cache_t *c, struct cache_entry *e){
+    if (e->prev != NULL) e->prev->next = e->next;
+    else c->head = e->next;
+    if (e->next != NULL) e->next->prev = e->prev;
+    else c->tail = e->prev;
+}
+
+void cache_push_front(regex_cache_t *c, struct cache_entry *e){
+    e->prev = NULL;
+    e->next = c->head;
+    if (c->head != NULL) c->head->prev = e;
+    c->head = e;
+    if (c->tail == NULL) c->tail = e;
+}
+
+struct cache_entry *cache_find(regex_cache_t *c, const char *regex){
+    struct cache_entry *e = c->table[hash_string(regex) % CACHE_HASH_SIZE];
+    while (e != NULL && strcmp(e->regex, regex) != 0) e = e->hash_next;
+    return e;
+}
+
+void cache_remove(regex_cache_t *c, struct cache_entry *e){
+    struct cache_entry **q = &c->table[hash_string(e->regex) % CACHE_HASH_SIZE];
+    while (*q != e) q = &(*q)->hash_next;
+    *q = e->hash_next;
+    cache_unlink(c, e);
+    program_free(e->p);
+    free(e->regex);
+    free(e);
+    c->length--;
+}
+
+const program_t *regex_cache_acquire(regex_cache_t *c, char *regex){
+    pthread_mutex_lock(&c->lock);
+    struct cache_entry *e = cache_find(c, regex);
+    if (e != NULL) {
+        cache_unlink(c, e);
+    } else {
+        e = malloc(sizeof(struct cache_entry));
+        e->regex = strdup(regex);
+        e->p = compile_regex(regex);
+        e->refs = 0;
+        unsigned h = hash_string(regex) % CACHE_HASH_SIZE;
+        e->hash_next = c->table[h];
+        c->table[h] = e;
+        c->length++;
+    }
+    cache_push_front(c, e);
+    e->refs++;
+    struct cache_entry *victim = c->tail;
+    while (c->length > c->capacity && victim != NULL) {
+        struct cache_entry *prev = victim->prev;
+        if (victim->refs == 0) cache_remove(c, victim);
+        victim = prev;
+    }
+    pthread_mutex_unlock(&c->lock);
+    return e->p;
+}
+
+void regex_cache_release(regex_cache_t *c, char *regex){
+    pthread_mutex_lock(&c->lock);
+    struct cache_entry *e = cache_find(c, regex);
+    assert(e != NULL && e->refs > 0);
+    e->refs--;
+    pthread_mutex_unlock(&c->lock);
+}
+
+void regex_cache_free(regex_cache_t *c){
+    while (c->head != NULL) cache_remove(c, c->head);
+    pthread_mutex_destroy(&c->lock);
+    free(c);
+}
+
+/*Extraction de littéraux obligatoires, directement sur l’expression postfixe. Pour chaque
+sous-expression e, on calcule :
+■ exact : l’unique mot reconnu par e s’il n’y en a qu’un, NULL sinon ;
+■ prefix (resp. suffix) : un mot par lequel commence (resp. finit) tout mot reconnu ;
+■ req : un mot facteur de tout mot reconnu (le plus long trouvé).
+Quand exact n’est pas NULL, les trois autres champs lui sont égaux. Toutes les chaînes
+sont allouées sur le tas.*/
+
+struct lit_info {
+    char *exact;
+    char *prefix;
+    char *suffix;
+    char *req;
+};
+
+typedef struct lit_info lit_info_t;
+
+struct literals {
+    char *prefix;
+    char *suffix;
+    char *req;
+};
+
+typedef struct literals literals_t;
+
+char *str_concat(const char *a, const char *b){
+    size_t la = strlen(a);
+    size_t lb = strlen(b);
+    char *r = malloc(la + lb + 1);
+    memcpy(r, a, la);
+    memcpy(r + la, b, lb + 1);
+    return r;
+}
+
+char *str_common_prefix(const char *a, const char *b){
+    size_t n = 0;
+    while (a[n] != '\0' && a[n] == b[n]) n++;
+    return strndup(a, n);
+}
+
+char *str_common_suffix(const char *a, const char *b){
+    size_t la = strlen(a);
+    size_t lb = strlen(b);
+    size_t n = 0;
+    while (n < la && n < lb && a[la - 1 - n] == b[lb - 1 - n]) n++;
+    return strdup(a + la - n);
+}
+
+lit_info_t lit_exact(char *w){
+    lit_info_t r = {w, strdup(w), strdup(w), strdup(w)};
+    return r;
+}
+
+lit_info_t lit_any(void){
+    lit_info_t r = {NULL, strdup(""), strdup(""), strdup("")};
+    return r;
+}
+
+void lit_free(lit_info_t x){
+    free(x.exact);
+    free(x.prefix);
+    free(x.suffix);
+    free(x.req);
+}
+
+char *str_longest(char *a, char *b){
+    if (strlen(a) >= strlen(b)) {
+        free(b);
+        return a;
+    }
+    free(a);
+    return b;
+}
+
+lit_info_t lit_concat(lit_info_t a, lit_info_t b){
+    lit_info_t r;
+    if (a.exact != NULL && b.exact != NULL) {
+        r = lit_exact(str_concat(a.exact, b.exact));
+    } else {
+        r.exact = NULL;
+        r.prefix = a.exact != NULL ? str_concat(a.exact, b.prefix) : strdup(a.prefix);
+        r.suffix = b.exact != NULL ? str_concat(a.suffix, b.exact) : strdup(b.suffix);
+        r.req = str_longest(str_longest(strdup(a.req), strdup(b.req)),
+                            str_concat(a.suffix, b.prefix));
+    }
+    lit_free(a);
+    lit_free(b);
+    return r;
+}
+
+lit_info_t lit_alternative(lit_info_t a, lit_info_t b){
+    lit_info_t r;
+    if (a.exact != NULL && b.exact != NULL && strcmp(a.exact, b.exact) == 0) {
+        r = lit_exact(strdup(a.exact));
+    } else {
+        r.exact = NULL;
+        r.prefix = str_common_prefix(a.prefix, b.prefix);
+        r.suffix = str_common_suffix(a.suffix, b.suffix);
+        r.req = str_longest(strdup(r.prefix), strdup(r.suffix));
+    }
+    lit_free(a);
+    lit_free(b);
+    return r;
+}
+
+literals_t *extract_literals(char *regex){
+    int size = strlen(regex);
+    lit_info_t *stack = malloc(size * sizeof(lit_info_t));
+    int length = 0;
+    for (int i = 0; i < size; i++) {
+        lit_info_t a;
+        lit_info_t b;
+        switch (regex[i]) {
+        case '@':
+            b = stack[--length];
+            a = stack[--length];
+            stack[length++] = lit_concat(a, b);
+            break;
+        case '|':
+            b = stack[--length];
+            a = stack[--length];
+            stack[length++] = lit_alternative(a, b);
+            break;
+        case '*':
+        case '?':
+            lit_free(stack[--length]);
+            stack[length++] = lit_any();
+            break;
+        case '.':
+            stack[length++] = lit_any();
+            break;
+        case '\\':
+            if (i + 1 < size && regex[i + 1] == '#') {
+                i++;
+            } else {
+                if (i + 1 < size) i++;
+                stack[length++] = lit_exact(strndup(&regex[i], 1));
+            }
+            break;
+        default:
+            stack[length++] = lit_exact(strndup(&regex[i], 1));
+            break;
+        }
+    }
+    assert(length == 1);
+    literals_t *lit = malloc(sizeof(literals_t));
+    lit->prefix = stack[0].prefix;
+    lit->suffix = stack[0].suffix;
+    lit->req = stack[0].req;
+    free(stack[0].exact);
+    free(stack);
+    return lit;
+}
+
+void literals_free(literals_t *lit){
+    free(lit->prefix);
+    free(lit->suffix);
+    free(lit->req);
+    free(lit);
+}
+
+/*fonction find_literal qui renvoie la position de la première occurrence de w (de
+longueur wlen > 0) dans s, ou NULL : memchr sur le premier octet, puis memcmp*/
 
-set_t *empty_set(int capacity, int id){
-    state_t **arr = malloc(capacity * sizeof(state_t*));
+const char *find_literal(const char *s, size_t len, const char *w, size_t wlen){
+    const char *end = s + len;
+    while ((size_t)(end - s) >= wlen) {
+        const char *c = memchr(s, w[0], end - s - wlen + 1);
+        if (c == NULL) return NULL;
+        if (memcmp(c + 1, w + 1, wlen - 1) == 0) return c;
+        s = c + 1;
+    }
+    return NULL;
+}
+
+
+set_t *empty_set(int capacity, uint64_t id){
+    int *arr = malloc(capacity * sizeof(int));
     set_t *s = malloc(sizeof(set_t));
     s->length = 0;
     s->id = id;
     s->states = arr;
+    s->marks = malloc(capacity * sizeof(uint64_t));
+    memset(s->marks, -1, capacity * sizeof(uint64_t));
     return s;
 }
 
 void set_free(set_t *s){
     free(s->states);
+    free(s->marks);
     free(s);
 }
 
@@ -252,9 +977,9 @@ void set_free(set_t *s){
 ■ set est un pointeur valide vers une structure de type set;
 ■ set.length >= 0;
 ■ set.states est suffisamment grand pour contenir tous les états ;
-■ s est soit le pointeur nul, soit un pointeur vers un état de l’automate de Thompson ;
-■ les états présents dans set sont exactement les états x dont le champ last_set est égal
-au champ id de set (ce qui peut inclure l’état s).
+■ s est soit -1, soit l’indice d’un état de p ;
+■ les états présents dans set sont exactement les états x tels que set.marks[x]
+est égal au champ id de set (ce qui peut inclure l’état s).
 Postconditions :
 ■ l’état s a été ajouté à set (s’il n’y était pas déjà) ;
 ■ tous les états accessibles depuis s en n’utilisant que des ε-transitions l’ont également
@@ -262,14 +987,14 @@ Postconditions :
 ■ les champs des différents objets ont été mis à jour pour conserver les invariants.*/
 
 
-void add_state(set_t *set, state_t *s){
-    if (s == NULL || s->last_set == set->id) return;
-    s->last_set = set->id;
+void add_state(const program_t *p, set_t *set, int s){
+    if (s < 0 || set->marks[s] == set->id) return;
+    set->marks[s] = set->id;
     set->states[set->length] = s;
     set->length++;
-    if (s->c == EPS) {
-        add_state(set,s->out1);
-        add_state(set,s->out2);
+    if (p->states[s].c == EPS) {
+        add_state(p, set, p->states[s].out1);
+        add_state(p, set, p->states[s].out2);
     }
 }
 
@@ -280,15 +1005,16 @@ les états nécessaires.
 Postconditions :
 ■ new_set contient l’ensemble des états accessibles depuis les états de old_set en effectuant une transition étiquetée par c, plus éventuellement des ε-transitions ;
 ■ l’identifiant de new_set est incrémenté de une unité par rapport à celui de old_set (et
-le champ last_set a été mis à jour en conséquence dans les états concernés).*/
+le tableau marks de new_set a été mis à jour en conséquence).*/
 
 
-void step(set_t *old_set, char c, set_t *new_set){
+void step(const program_t *p, set_t *old_set, char c, set_t *new_set){
     new_set->id = old_set->id + 1;
+    new_set->length = 0;
     for (int i = 0; i < old_set->length; i++){
-        state_t* s = old_set->states[i];
+        const flat_state_t *s = &p->states[old_set->states[i]];
         if (s->c == c || s->c == ALL){
-            add_state(new_set,s->out1);
+            add_state(p, new_set, s->out1);
         }
     }
 }
@@ -298,54 +1024,1321 @@ ou false suivant que le mot (la chaîne) est reconnu ou pas. À nouveau, on cons
 le mot se termine juste avant le premier caractère '\n ou '\0' rencontré.
 */
 
-bool accept(nfa_t a, char *s, set_t *s1, set_t *s2){
+bool accept_n(const program_t *p, const char *s, size_t len, set_t *s1, set_t *s2){
+    // les identifiants doivent rester strictement croissants d’un appel à l’autre
+    s1->id = (s1->id > s2->id ? s1->id : s2->id) + 1;
     s1->length = 0;
-    add_state(s1, a.start);
-    int i = 0;
-    while (s[i] != '\0'&& s[i] != '\n') {
-        step(s1, s[i], s2);
+    add_state(p, s1, p->start);
+    for (size_t i = 0; i < len; i++) {
+        step(p, s1, s[i], s2);
         set_t *tmp = s1;
         s1 = s2;
         s2 = tmp;
-        i++;
     }
-    return a.final->last_set == s1->id;
+    return s1->marks[p->final] == s1->id;
+}
+
+bool accept(const program_t *p, char *s, set_t *s1, set_t *s2){
+    return accept_n(p, s, strcspn(s, "\n"), s1, s2);
+}
+
+/*fonction search_n qui renvoie true si un facteur du mot s (de longueur len) est reconnu.
+L’état initial est réinjecté dans l’ensemble courant à chaque position, ce qui revient à
+lancer une simulation depuis chaque position en une seule passe.*/
+
+bool search_n(const program_t *p, const char *s, size_t len, set_t *s1, set_t *s2){
+    s1->id = (s1->id > s2->id ? s1->id : s2->id) + 1;
+    s1->length = 0;
+    add_state(p, s1, p->start);
+    for (size_t i = 0; i < len; i++) {
+        if (s1->marks[p->final] == s1->id) return true;
+        step(p, s1, s[i], s2);
+        add_state(p, s2, p->start);
+        set_t *tmp = s1;
+        s1 = s2;
+        s2 = tmp;
+    }
+    return s1->marks[p->final] == s1->id;
 }
 
 /*fonction match_stream ayant le même comportement que
 match_stream_backtrack mais utilisant la nouvelle méthode d’exécution de l’automate. On ne créera que deux set_t au total.*/
 
-void match_stream(nfa_t a, FILE *in){
-    char line[MAX_LINE_LENGTH + 1];
-    set_t *s1 = empty_set(a.n, 0);
-    set_t *s2 = empty_set(a.n, 1);
-    while (fgets(line, MAX_LINE_LENGTH, in) != NULL) {
-        if (accept(a, line, s1, s2)) printf("%s", line);
-        s1->id++;
+/*Liste des motifs reconnus sur la ligne courante, sans doublon (seen[k] == stamp si le
+motif k est déjà dans la liste)*/
+
+struct match_list {
+    int length;
+    int *ids;
+    uint64_t *seen;
+    uint64_t stamp;
+};
+
+typedef struct match_list match_list_t;
+
+match_list_t *match_list_new(int nb_patterns){
+    match_list_t *ml = malloc(sizeof(match_list_t));
+    ml->length = 0;
+    ml->ids = malloc(nb_patterns * sizeof(int));
+    ml->seen = malloc(nb_patterns * sizeof(uint64_t));
+    memset(ml->seen, -1, nb_patterns * sizeof(uint64_t));
+    ml->stamp = 0;
+    return ml;
+}
+
+void match_list_free(match_list_t *ml){
+    free(ml->ids);
+    free(ml->seen);
+    free(ml);
+}
+
+void match_list_reset(match_list_t *ml){
+    ml->length = 0;
+    ml->stamp++;
+}
+
+void match_list_add(match_list_t *ml, int k){
+    if (ml->seen[k] == ml->stamp) return;
+    ml->seen[k] = ml->stamp;
+    ml->ids[ml->length++] = k;
+}
+
+/*fonction collect_matches qui ajoute à ml les motifs dont l’état final est dans set*/
+
+void collect_matches(const program_t *p, const set_t *set, match_list_t *ml){
+    for (int i = 0; i < set->length; i++) {
+        int k = p->pattern[set->states[i]];
+        if (k >= 0) match_list_add(ml, k);
     }
-    set_free(s1);
-    set_free(s2);
 }
 
-int main(int argc, char* argv[]){
-    assert(argc >= 2);
-    FILE* in_f = stdin;
-    if (argc = 3) {
-        in_f = fopen(argv[2],"r");
+/*fonction match_all_n qui range dans ml tous les motifs de p reconnus par s (ou par un de
+ses facteurs si unanchored) ; on ne peut pas s’arrêter au premier motif reconnu*/
+
+bool match_all_n(const program_t *p, const char *s, size_t len, set_t *s1, set_t *s2,
+                 bool unanchored, match_list_t *ml){
+    match_list_reset(ml);
+    s1->id = (s1->id > s2->id ? s1->id : s2->id) + 1;
+    s1->length = 0;
+    add_state(p, s1, p->start);
+    for (size_t i = 0; i < len; i++) {
+        if (unanchored) collect_matches(p, s1, ml);
+        step(p, s1, s[i], s2);
+        if (unanchored) add_state(p, s2, p->start);
+        set_t *tmp = s1;
+        s1 = s2;
+        s2 = tmp;
     }
-    nfa_t a = build(argv[1]);
-    match_stream_backtrack(a,in_f);
-    if (argc >= 3 ) fclose(in_f);
-    return 0;
+    collect_matches(p, s1, ml);
+    return ml->length > 0;
 }
 
-void free_accessible_states(state_t *q){
-    if (q == NULL) return;
-    free_accessible(q->out1);
-    free_accessible(q->out2);
-    free(q);
+struct nfa_matcher {
+    const program_t *p;
+    set_t *s1;
+    set_t *s2;
+    bool unanchored;
+    match_list_t *ml;
+};
+
+bool nfa_match(void *ctx, const char *line, size_t len){
+    struct nfa_matcher *m = ctx;
+    if (m->p->nb_patterns > 1) {
+        return match_all_n(m->p, line, len, m->s1, m->s2, m->unanchored, m->ml);
+    }
+    if (m->unanchored) return search_n(m->p, line, len, m->s1, m->s2);
+    return accept_n(m->p, line, len, m->s1, m->s2);
 }
 
-void free_automaton(nfa_t a){
-    free_accessible(a.start);
+void match_stream(const program_t *p, FILE *in){
+    struct nfa_matcher m = {p, empty_set(p->n, 0), empty_set(p->n, 1), false,
+                            match_list_new(p->nb_patterns)};
+    match_lines(in, nfa_match, NULL, &m);
+    set_free(m.s1);
+    set_free(m.s2);
+    match_list_free(m.ml);
+}
+
+/*Exécution par retour sur trace sans explosion combinatoire (comme BitState dans RE2).
+On explore les couples (état, position) en profondeur avec une pile explicite, en
+essayant out1 avant out2, et on marque chaque couple visité dans un tableau de bits : un
+couple déjà visité a déjà échoué, on ne le réexplore pas. Chaque couple est donc traité
+au plus une fois, et le temps est linéaire en n * (len + 1), y compris sur les cycles
+d’ε-transitions créés par star. Le tableau de bits est limité à BITSTATE_MAX_BITS bits :
+au-delà (ligne trop longue pour l’automate), on utilise la simulation par ensembles.
+En recherche non ancrée, on lance l’exploration depuis chaque position en gardant les
+marques : un couple qui a échoué depuis une position de départ échoue depuis toutes.*/
+
+#define BITSTATE_MAX_BITS (256 * 1024)
+
+struct job {
+    int state;
+    size_t pos;
+};
+
+struct bitstate {
+    const program_t *p;
+    bool unanchored;
+    uint64_t *visited;
+    struct job *stack;
+    size_t stack_capacity;
+    set_t *s1;
+    set_t *s2;
+};
+
+typedef struct bitstate bitstate_t;
+
+bitstate_t *bitstate_new(const program_t *p, bool unanchored){
+    bitstate_t *b = malloc(sizeof(bitstate_t));
+    b->p = p;
+    b->unanchored = unanchored;
+    b->visited = malloc(BITSTATE_MAX_BITS / 8);
+    b->stack_capacity = 64;
+    b->stack = malloc(b->stack_capacity * sizeof(struct job));
+    b->s1 = empty_set(p->n, 0);
+    b->s2 = empty_set(p->n, 1);
+    return b;
+}
+
+void bitstate_free(bitstate_t *b){
+    free(b->visited);
+    free(b->stack);
+    set_free(b->s1);
+    set_free(b->s2);
+    free(b);
+}
+
+/*fonction bitstate_explore qui renvoie true si l’on atteint l’état final depuis (start,
+pos) en lisant s : à la fin du mot si prefix est faux, à n’importe quelle position sinon*/
+
+bool bitstate_explore(bitstate_t *b, int start, size_t pos, const char *s, size_t len,
+                      bool prefix){
+    const program_t *p = b->p;
+    size_t length = 0;
+    b->stack[length++] = (struct job){start, pos};
+    while (length > 0) {
+        struct job j = b->stack[--length];
+        if (j.state < 0) continue;
+        size_t bit = (size_t)j.state * (len + 1) + j.pos;
+        if (b->visited[bit / 64] & ((uint64_t)1 << (bit % 64))) continue;
+        b->visited[bit / 64] |= (uint64_t)1 << (bit % 64);
+        if (length + 2 > b->stack_capacity) {
+            b->stack_capacity *= 2;
+            b->stack = realloc(b->stack, b->stack_capacity * sizeof(struct job));
+        }
+        const flat_state_t *q = &p->states[j.state];
+        if (q->c == EPS) {
+            b->stack[length++] = (struct job){q->out2, j.pos};
+            b->stack[length++] = (struct job){q->out1, j.pos};
+        } else if (q->c == MATCH) {
+            if (prefix || j.pos == len) return true;
+        } else if (j.pos < len && (s[j.pos] == q->c || q->c == ALL)) {
+            b->stack[length++] = (struct job){q->out1, j.pos + 1};
+        }
+    }
+    return false;
+}
+
+/*fonction bitstate_accept, même contrat que accept_n (ou search_n si unanchored)*/
+
+bool bitstate_accept(bitstate_t *b, const char *s, size_t len){
+    const program_t *p = b->p;
+    size_t bits = (size_t)p->n * (len + 1);
+    if (bits > BITSTATE_MAX_BITS) {
+        if (b->unanchored) return search_n(p, s, len, b->s1, b->s2);
+        return accept_n(p, s, len, b->s1, b->s2);
+    }
+    memset(b->visited, 0, (bits + 63) / 64 * sizeof(uint64_t));
+    if (!b->unanchored) return bitstate_explore(b, p->start, 0, s, len, false);
+    for (size_t i = 0; i <= len; i++) {
+        if (bitstate_explore(b, p->start, i, s, len, true)) return true;
+    }
+    return false;
+}
+
+/*Cette fonction renverra true si la lecture du mot s depuis l’état initial nous amène
+dans un état final, false sinon. Comme pour accept, le mot s’arrête au premier caractère
+nul ou '\n' rencontré, exclu.*/
+
+bool accept_backtrack(const program_t *p, char *s){
+    bitstate_t *b = bitstate_new(p, false);
+    bool result = bitstate_accept(b, s, strcspn(s, "\n"));
+    bitstate_free(b);
+    return result;
+}
+
+bool backtrack_match(void *ctx, const char *line, size_t len){
+    return bitstate_accept(ctx, line, len);
+}
+
+void match_stream_backtrack(const program_t *p, FILE *in){
+    bitstate_t *b = bitstate_new(p, false);
+    match_lines(in, backtrack_match, NULL, b);
+    bitstate_free(b);
+}
+
+/*Machine de Pike : simulation par ensembles où chaque état de l’ensemble (un « thread »)
+porte ses captures, c’est-à-dire les positions enregistrées par les états SAVE traversés.
+Les threads sont rangés par priorité décroissante (out1 avant out2) ; quand deux chemins
+arrivent au même état, seul le premier (le plus prioritaire) est gardé, si bien que
+l’ensemble a toujours au plus n threads et que le temps reste linéaire en n * len.
+Le premier thread qui atteint l’état final donne l’occurrence retenue, et les threads
+moins prioritaires sont abandonnés. En recherche non ancrée, on ajoute un nouveau thread
+(de plus basse priorité) à chaque position tant qu’aucune occurrence n’a été trouvée :
+on obtient l’occurrence la plus à gauche, puis la plus prioritaire.
+Les captures sont partagées entre threads et copiées seulement quand un thread modifie
+un tableau qu’un autre utilise aussi (compteur de références refs) ; les tableaux libérés
+sont gardés dans une liste pour être réutilisés.*/
+
+#define UNSET ((size_t)-1)
+
+struct captures {
+    int refs;
+    struct captures *next;
+    size_t slots[];
+};
+
+typedef struct captures captures_t;
+
+struct thread {
+    int state;
+    captures_t *caps;
+};
+
+struct thread_list {
+    int length;
+    struct thread *threads;
+};
+
+struct pike {
+    const program_t *p;
+    bool unanchored;
+    struct thread_list clist;
+    struct thread_list nlist;
+    uint64_t *marks;
+    uint64_t generation;
+    captures_t *free_list;
+    const char *base;
+    size_t *match;
+};
+
+typedef struct pike pike_t;
+
+pike_t *pike_new(const program_t *p, bool unanchored){
+    pike_t *vm = malloc(sizeof(pike_t));
+    vm->p = p;
+    vm->unanchored = unanchored;
+    vm->clist.threads = malloc(p->n * sizeof(struct thread));
+    vm->nlist.threads = malloc(p->n * sizeof(struct thread));
+    vm->marks = malloc(p->n * sizeof(uint64_t));
+    memset(vm->marks, -1, p->n * sizeof(uint64_t));
+    vm->generation = 0;
+    vm->free_list = NULL;
+    vm->base = NULL;
+    vm->match = malloc(p->nb_slots * sizeof(size_t));
+    return vm;
+}
+
+void pike_free(pike_t *vm){
+    while (vm->free_list != NULL) {
+        captures_t *next = vm->free_list->next;
+        free(vm->free_list);
+        vm->free_list = next;
+    }
+    free(vm->clist.threads);
+    free(vm->nlist.threads);
+    free(vm->marks);
+    free(vm->match);
+    free(vm);
+}
+
+captures_t *captures_new(pike_t *vm){
+    captures_t *c = vm->free_list;
+    if (c != NULL) vm->free_list = c->next;
+    else c = malloc(sizeof(captures_t) + vm->p->nb_slots * sizeof(size_t));
+    c->refs = 1;
+    return c;
+}
+
+void captures_release(pike_t *vm, captures_t *c){
+    c->refs--;
+    if (c->refs == 0) {
+        c->next = vm->free_list;
+        vm->free_list = c;
+    }
+}
+
+/*fonction captures_set qui renvoie c avec la case k mise à value, en copiant c s’il est
+partagé ; la référence passée en argument est transférée au résultat*/
+
+captures_t *captures_set(pike_t *vm, captures_t *c, int k, size_t value){
+    if (c->refs > 1) {
+        captures_t *copy = captures_new(vm);
+        memcpy(copy->slots, c->slots, vm->p->nb_slots * sizeof(size_t));
+        c->refs--;
+        c = copy;
+    }
+    c->slots[k] = value;
+    return c;
+}
+
+/*fonction add_thread, analogue de add_state : ajoute à list les threads obtenus depuis
+l’état s par ε-transitions, en mettant à jour les captures ; la référence caps est
+consommée*/
+
+void add_thread(pike_t *vm, struct thread_list *list, int s, captures_t *caps, size_t pos){
+    const program_t *p = vm->p;
+    if (s < 0 || vm->marks[s] == vm->generation) {
+        captures_release(vm, caps);
+        return;
+    }
+    vm->marks[s] = vm->generation;
+    if (p->save[s] >= 0) {
+        caps = captures_set(vm, caps, p->save[s], pos);
+        add_thread(vm, list, p->states[s].out1, caps, pos);
+    } else if (p->states[s].c == EPS) {
+        caps->refs++;
+        add_thread(vm, list, p->states[s].out1, caps, pos);
+        add_thread(vm, list, p->states[s].out2, caps, pos);
+    } else {
+        list->threads[list->length].state = s;
+        list->threads[list->length].caps = caps;
+        list->length++;
+    }
+}
+
+void add_start_thread(pike_t *vm, struct thread_list *list, size_t pos){
+    captures_t *caps = captures_new(vm);
+    for (int k = 0; k < vm->p->nb_slots; k++) caps->slots[k] = UNSET;
+    add_thread(vm, list, vm->p->start, caps, pos);
+}
+
+/*fonction pike_search qui renvoie true si s (de longueur len) est reconnu (ou l’un de ses
+facteurs si unanchored) ; les captures de l’occurrence retenue sont alors dans vm->match,
+sous forme de positions dans s (UNSET pour un groupe qui n’a rien capturé)*/
+
+bool pike_search(pike_t *vm, const char *s, size_t len){
+    const program_t *p = vm->p;
+    bool matched = false;
+    vm->base = s;
+    vm->generation++;
+    vm->clist.length = 0;
+    add_start_thread(vm, &vm->clist, 0);
+    for (size_t pos = 0; pos <= len && vm->clist.length > 0; pos++) {
+        vm->generation++;
+        vm->nlist.length = 0;
+        int i;
+        for (i = 0; i < vm->clist.length; i++) {
+            struct thread t = vm->clist.threads[i];
+            int c = p->states[t.state].c;
+            if (c == MATCH) {
+                if (vm->unanchored || pos == len) {
+                    memcpy(vm->match, t.caps->slots, p->nb_slots * sizeof(size_t));
+                    matched = true;
+                    captures_release(vm, t.caps);
+                    break;
+                }
+            } else if (pos < len && (c == s[pos] || c == ALL)) {
+                add_thread(vm, &vm->nlist, p->states[t.state].out1, t.caps, pos + 1);
+                continue;
+            }
+            captures_release(vm, t.caps);
+        }
+        // threads moins prioritaires que l’occurrence trouvée
+        for (i++; i < vm->clist.length; i++) captures_release(vm, vm->clist.threads[i].caps);
+        struct thread_list tmp = vm->clist;
+        vm->clist = vm->nlist;
+        vm->nlist = tmp;
+        if (vm->unanchored && !matched && pos < len) add_start_thread(vm, &vm->clist, pos + 1);
+    }
+    for (int i = 0; i < vm->clist.length; i++) captures_release(vm, vm->clist.threads[i].caps);
+    vm->clist.length = 0;
+    return matched;
+}
+
+bool pike_match(void *ctx, const char *line, size_t len){
+    return pike_search(ctx, line, len);
+}
+
+/*fonction pike_emit_only qui écrit, pour une ligne reconnue, chaque occurrence du motif
+(la première est déjà dans vm->match) sur une ligne, suivie du contenu de chaque groupe
+séparé par des tabulations ; en mode ancré, l’unique occurrence est la ligne entière, et
+en mode non ancré on n’écrit pas les occurrences vides (comme grep -o).*/
+
+void pike_emit_only(pike_t *vm, const char *line, size_t len, FILE *out){
+    size_t offset = vm->base - line;
+    while (true) {
+        if (!vm->unanchored || vm->match[1] > vm->match[0]) {
+            for (int k = 0; k + 1 < vm->p->nb_slots; k += 2) {
+                size_t start = vm->match[k];
+                size_t end = vm->match[k + 1];
+                if (k > 0) putc('\t', out);
+                if (start != UNSET && end != UNSET) fwrite(line + offset + start, 1, end - start, out);
+            }
+            putc('\n', out);
+        }
+        if (!vm->unanchored) return;
+        // occurrence suivante, en avançant d’un caractère après une occurrence vide
+        size_t next = offset + vm->match[1] + (vm->match[1] == vm->match[0]);
+        if (next > len || !pike_search(vm, line + next, len - next)) return;
+        offset = next;
+    }
+}
+
+void pike_emit(void *ctx, const char *line, size_t len, FILE *out){
+    pike_emit_only(ctx, line, len, out);
+}
+
+/*fonction match_stream_only_matching, comme match_stream mais n’écrit que les parties
+reconnues (voir pike_emit_only)*/
+
+void match_stream_only_matching(const program_t *p, FILE *in, bool unanchored){
+    pike_t *vm = pike_new(p, unanchored);
+    match_lines(in, pike_match, pike_emit, vm);
+    pike_free(vm);
+}
+
+/*Exécution par automate déterministe construit paresseusement (comme dans RE2). Un état
+du DFA est un ensemble d’états de l’automate de Thompson (clos par ε-transitions), stocké
+trié par indice pour pouvoir être haché et comparé. Sa ligne de transitions next est
+remplie à la demande : next[k] == NULL signifie que la transition par les octets de la
+classe k n’a pas encore été calculée (elle l’est alors par step, comme dans la
+simulation par ensembles) ; elle a une case par classe d’octets (byte_class).
+Les états sont mémorisés dans une table de hachage dont la taille totale est bornée par
+budget octets ; quand elle est pleine, on vide tout le cache et on continue. Si le cache
+a dû être vidé plus de DFA_MAX_FLUSHES fois, il est inefficace pour cet automate, et on
+repasse définitivement à la simulation par ensembles (accept).
+En recherche non ancrée (unanchored), l’état initial est ajouté à chaque transition comme
+dans search_n, et on s’arrête dès qu’on atteint un état acceptant.
+Avec plusieurs motifs, chaque état mémorise la liste matches des motifs dont il contient
+l’état final, et on ne s’arrête plus au premier motif reconnu.*/
+
+#define DFA_HASH_SIZE 4096
+#define DFA_MEMORY_BUDGET (8 << 20)
+#define DFA_MAX_FLUSHES 16
+
+struct dfa_state {
+    int length;
+    int *states;
+    bool accepting;
+    int nb_matches;
+    int *matches;
+    unsigned hash;
+    struct dfa_state *hash_next;
+    struct dfa_state *next[];
+};
+
+typedef struct dfa_state dfa_state_t;
+
+struct lazy_dfa {
+    const program_t *p;
+    dfa_state_t **table;
+    dfa_state_t *start;
+    size_t memory;
+    size_t budget;
+    int nb_flushes;
+    bool failed;
+    bool unanchored;
+    set_t *s1;
+    set_t *s2;
+    match_list_t *ml;
+};
+
+typedef struct lazy_dfa lazy_dfa_t;
+
+lazy_dfa_t *lazy_dfa_new(const program_t *p, size_t budget, bool unanchored){
+    lazy_dfa_t *d = malloc(sizeof(lazy_dfa_t));
+    d->p = p;
+    d->table = calloc(DFA_HASH_SIZE, sizeof(dfa_state_t*));
+    d->start = NULL;
+    d->memory = 0;
+    d->budget = budget;
+    d->nb_flushes = 0;
+    d->failed = false;
+    d->unanchored = unanchored;
+    d->s1 = empty_set(p->n, 0);
+    d->s2 = empty_set(p->n, 1);
+    d->ml = match_list_new(p->nb_patterns);
+    return d;
+}
+
+void lazy_dfa_flush(lazy_dfa_t *d){
+    for (int i = 0; i < DFA_HASH_SIZE; i++) {
+        dfa_state_t *q = d->table[i];
+        while (q != NULL) {
+            dfa_state_t *next = q->hash_next;
+            free(q->states);
+            free(q->matches);
+            free(q);
+            q = next;
+        }
+        d->table[i] = NULL;
+    }
+    d->start = NULL;
+    d->memory = 0;
+    d->nb_flushes++;
+}
+
+void lazy_dfa_free(lazy_dfa_t *d){
+    lazy_dfa_flush(d);
+    free(d->table);
+    set_free(d->s1);
+    set_free(d->s2);
+    match_list_free(d->ml);
+    free(d);
+}
+
+int compare_ints(const void *x, const void *y){
+    int p = *(const int*)x;
+    int q = *(const int*)y;
+    return (p > q) - (p < q);
+}
+
+/*fonction dfa_intern qui renvoie l’état du DFA correspondant à l’ensemble set (dont le
+tableau states est trié au passage), en le créant s’il n’existe pas encore. Renvoie
+NULL si le cache a été vidé trop souvent.*/
+
+dfa_state_t *dfa_intern(lazy_dfa_t *d, set_t *set){
+    qsort(set->states, set->length, sizeof(int), compare_ints);
+    unsigned hash = 2166136261u;
+    for (int i = 0; i < set->length; i++) {
+        hash = (hash ^ (unsigned)set->states[i]) * 16777619u;
+    }
+    for (dfa_state_t *q = d->table[hash % DFA_HASH_SIZE]; q != NULL; q = q->hash_next) {
+        if (q->hash == hash && q->length == set->length &&
+            memcmp(q->states, set->states, set->length * sizeof(int)) == 0) {
+            return q;
+        }
+    }
+    size_t row = d->p->nb_classes * sizeof(dfa_state_t*);
+    size_t cost = sizeof(dfa_state_t) + row + set->length * sizeof(int);
+    if (d->memory + cost > d->budget) {
+        lazy_dfa_flush(d);
+        if (d->nb_flushes > DFA_MAX_FLUSHES) {
+            d->failed = true;
+            return NULL;
+        }
+    }
+    dfa_state_t *q = malloc(sizeof(dfa_state_t) + row);
+    q->length = set->length;
+    q->states = malloc(set->length * sizeof(int));
+    memcpy(q->states, set->states, set->length * sizeof(int));
+    // chaque motif n’a qu’un état final : pas de doublon dans matches
+    q->nb_matches = 0;
+    for (int i = 0; i < set->length; i++) {
+        if (d->p->pattern[set->states[i]] >= 0) q->nb_matches++;
+    }
+    q->matches = malloc(q->nb_matches * sizeof(int));
+    q->nb_matches = 0;
+    for (int i = 0; i < set->length; i++) {
+        int k = d->p->pattern[set->states[i]];
+        if (k >= 0) q->matches[q->nb_matches++] = k;
+    }
+    q->accepting = q->nb_matches > 0;
+    d->memory += q->nb_matches * sizeof(int);
+    q->hash = hash;
+    for (int k = 0; k < d->p->nb_classes; k++) q->next[k] = NULL;
+    q->hash_next = d->table[hash % DFA_HASH_SIZE];
+    d->table[hash % DFA_HASH_SIZE] = q;
+    d->memory += cost;
+    return q;
+}
+
+/*fonction dfa_transition qui calcule (et mémorise) la transition de q par c*/
+
+dfa_state_t *dfa_transition(lazy_dfa_t *d, dfa_state_t *q, char c){
+    set_t *s1 = d->s1;
+    s1->id = (s1->id > d->s2->id ? s1->id : d->s2->id) + 1;
+    s1->length = q->length;
+    for (int i = 0; i < q->length; i++) {
+        s1->states[i] = q->states[i];
+        s1->marks[q->states[i]] = s1->id;
+    }
+    step(d->p, s1, c, d->s2);
+    if (d->unanchored) add_state(d->p, d->s2, d->p->start);
+    int nb_flushes = d->nb_flushes;
+    dfa_state_t *r = dfa_intern(d, d->s2);
+    // si le cache a été vidé, q n’existe plus
+    if (r != NULL && d->nb_flushes == nb_flushes) q->next[d->p->byte_class[(unsigned char)c]] = r;
+    return r;
+}
+
+dfa_state_t *dfa_start(lazy_dfa_t *d){
+    if (d->start == NULL) {
+        set_t *s1 = d->s1;
+        s1->id = (s1->id > d->s2->id ? s1->id : d->s2->id) + 1;
+        s1->length = 0;
+        add_state(d->p, s1, d->p->start);
+        d->start = dfa_intern(d, s1);
+    }
+    return d->start;
+}
+
+/*fonction dfa_accept, même contrat que accept_n*/
+
+bool dfa_accept(lazy_dfa_t *d, const char *s, size_t len){
+    dfa_state_t *q = d->failed ? NULL : dfa_start(d);
+    for (size_t i = 0; q != NULL && i < len; i++) {
+        if (d->unanchored && q->accepting) return true;
+        dfa_state_t *next = q->next[d->p->byte_class[(unsigned char)s[i]]];
+        if (next == NULL) next = dfa_transition(d, q, s[i]);
+        q = next;
+    }
+    if (d->failed) {
+        if (d->unanchored) return search_n(d->p, s, len, d->s1, d->s2);
+        return accept_n(d->p, s, len, d->s1, d->s2);
+    }
+    return q->accepting;
+}
+
+/*fonction dfa_match_all, même contrat que match_all_n (la liste est d->ml)*/
+
+bool dfa_match_all(lazy_dfa_t *d, const char *s, size_t len){
+    dfa_state_t *q = d->failed ? NULL : dfa_start(d);
+    match_list_reset(d->ml);
+    for (size_t i = 0; q != NULL && i < len; i++) {
+        if (d->unanchored) {
+            for (int k = 0; k < q->nb_matches; k++) match_list_add(d->ml, q->matches[k]);
+        }
+        dfa_state_t *next = q->next[d->p->byte_class[(unsigned char)s[i]]];
+        if (next == NULL) next = dfa_transition(d, q, s[i]);
+        q = next;
+    }
+    if (d->failed) return match_all_n(d->p, s, len, d->s1, d->s2, d->unanchored, d->ml);
+    for (int k = 0; k < q->nb_matches; k++) match_list_add(d->ml, q->matches[k]);
+    return d->ml->length > 0;
+}
+
+bool dfa_match(void *ctx, const char *line, size_t len){
+    lazy_dfa_t *d = ctx;
+    if (d->p->nb_patterns > 1) return dfa_match_all(d, line, len);
+    return dfa_accept(d, line, len);
+}
+
+void match_stream_dfa(const program_t *p, FILE *in){
+    lazy_dfa_t *d = lazy_dfa_new(p, DFA_MEMORY_BUDGET, false);
+    match_lines(in, dfa_match, NULL, d);
+    lazy_dfa_free(d);
+}
+
+/*Simulation bit-parallèle (à la Glushkov / Shift-And). Les positions sont les états qui
+lisent un caractère, plus l’état final ; on élimine les ε-transitions en calculant pour
+chaque position q l’ensemble follow[q] des positions accessibles après avoir lu le
+caractère de q, et l’ensemble initial des positions accessibles depuis le départ.
+Un ensemble de positions est un masque de words mots de 64 bits (au plus BP_MAX_WORDS).
+À chaque octet b, on ne garde que les positions qui acceptent b (table chars), puis on
+fait l’union de leurs follow, précalculée pour chaque bloc de 8 positions et chacune
+des 256 valeurs possibles du bloc (table follow). En recherche non ancrée, on ajoute
+l’ensemble initial après chaque octet.*/
+
+#define BP_MAX_WORDS 4
+#define BP_MAX_POSITIONS (64 * BP_MAX_WORDS)
+
+struct bit_parallel {
+    int words;
+    int nb_chunks;
+    bool unanchored;
+    uint64_t init[BP_MAX_WORDS];
+    uint64_t final[BP_MAX_WORDS];
+    uint64_t chars[256][BP_MAX_WORDS];
+    uint64_t *follow;
+};
+
+typedef struct bit_parallel bit_parallel_t;
+
+int count_positions(const program_t *p){
+    int nb = 0;
+    for (int i = 0; i < p->n; i++) {
+        if (p->states[i].c != EPS) nb++;
+    }
+    return nb;
+}
+
+/*fonction bp_closure qui ajoute à mask les positions accessibles depuis l’état s par
+ε-transitions (seen[x] == stamp marque les états déjà vus)*/
+
+void bp_closure(const program_t *p, int s, const int *pos, uint64_t *mask, int *seen, int stamp){
+    if (s < 0 || seen[s] == stamp) return;
+    seen[s] = stamp;
+    if (p->states[s].c == EPS) {
+        bp_closure(p, p->states[s].out1, pos, mask, seen, stamp);
+        bp_closure(p, p->states[s].out2, pos, mask, seen, stamp);
+    } else {
+        mask[pos[s] / 64] |= (uint64_t)1 << (pos[s] % 64);
+    }
+}
+
+/*fonction bp_new qui renvoie NULL si l’automate a plus de BP_MAX_POSITIONS positions*/
+
+bit_parallel_t *bp_new(const program_t *p, bool unanchored){
+    int nb = count_positions(p);
+    if (nb > BP_MAX_POSITIONS) return NULL;
+    bit_parallel_t *bp = calloc(1, sizeof(bit_parallel_t));
+    bp->unanchored = unanchored;
+    bp->words = (nb + 63) / 64;
+    bp->nb_chunks = (nb + 7) / 8;
+    int w = bp->words;
+    int *pos = malloc(p->n * sizeof(int));
+    memset(pos, -1, p->n * sizeof(int));
+    int *state = malloc((nb + 1) * sizeof(int));
+    int *seen = malloc(p->n * sizeof(int));
+    memset(seen, -1, p->n * sizeof(int));
+    uint64_t *follow = calloc(nb + 1, BP_MAX_WORDS * sizeof(uint64_t));
+    nb = 0;
+    for (int i = 0; i < p->n; i++) {
+        if (p->states[i].c != EPS) {
+            if (i == p->final) bp->final[nb / 64] = (uint64_t)1 << (nb % 64);
+            state[nb] = i;
+            pos[i] = nb++;
+        }
+    }
+    bp_closure(p, p->start, pos, bp->init, seen, 0);
+    for (int q = 0; q < nb; q++) {
+        const flat_state_t *f = &p->states[state[q]];
+        if (f->c == MATCH) continue;
+        bp_closure(p, f->out1, pos, &follow[q * BP_MAX_WORDS], seen, q + 1);
+        for (int b = 0; b < 256; b++) {
+            if (f->c == ALL || f->c == (char)b) {
+                bp->chars[b][q / 64] |= (uint64_t)1 << (q % 64);
+            }
+        }
+    }
+    bp->follow = calloc((size_t)bp->nb_chunks * 256 * w, sizeof(uint64_t));
+    for (int j = 0; j < bp->nb_chunks; j++) {
+        for (int v = 1; v < 256; v++) {
+            // union des follow des positions 8j + k pour les bits k de v, par récurrence
+            int k = __builtin_ctz(v);
+            uint64_t *row = &bp->follow[((size_t)j * 256 + v) * w];
+            const uint64_t *rest = &bp->follow[((size_t)j * 256 + (v & (v - 1))) * w];
+            int q = 8 * j + k;
+            for (int x = 0; x < w; x++) {
+                row[x] = rest[x] | (q < nb ? follow[q * BP_MAX_WORDS + x] : 0);
+            }
+        }
+    }
+    free(pos);
+    free(state);
+    free(seen);
+    free(follow);
+    return bp;
+}
+
+void bp_free(bit_parallel_t *bp){
+    free(bp->follow);
+    free(bp);
+}
+
+/*fonction bp_accept, même contrat que accept_n ; le cas d’un seul mot est traité à part*/
+
+bool bp_accept(const bit_parallel_t *bp, const char *s, size_t len){
+    if (bp->words == 1) {
+        uint64_t init = bp->init[0];
+        uint64_t final = bp->final[0];
+        uint64_t restart = bp->unanchored ? init : 0;
+        uint64_t d = init;
+        for (size_t i = 0; i < len && d != 0; i++) {
+            uint64_t m = d & bp->chars[(unsigned char)s[i]][0];
+            d = restart;
+            for (int j = 0; m != 0; j++, m >>= 8) {
+                d |= bp->follow[j * 256 + (m & 0xff)];
+            }
+            if (bp->unanchored && (d & final)) return true;
+        }
+        return (d & final) != 0;
+    }
+    int w = bp->words;
+    uint64_t d[BP_MAX_WORDS];
+    memcpy(d, bp->init, sizeof(d));
+    for (size_t i = 0; i < len; i++) {
+        const uint64_t *b = bp->chars[(unsigned char)s[i]];
+        uint64_t m[BP_MAX_WORDS];
+        uint64_t any = 0;
+        for (int x = 0; x < w; x++) {
+            m[x] = d[x] & b[x];
+            d[x] = bp->unanchored ? bp->init[x] : 0;
+        }
+        for (int x = 0; x < w; x++) {
+            uint64_t mx = m[x];
+            for (int j = 8 * x; mx != 0; j++, mx >>= 8) {
+                const uint64_t *row = &bp->follow[((size_t)j * 256 + (mx & 0xff)) * w];
+                for (int y = 0; y < w; y++) d[y] |= row[y];
+            }
+        }
+        for (int x = 0; x < w; x++) any |= d[x];
+        if (any == 0) return false;
+        for (int x = 0; bp->unanchored && x < w; x++) {
+            if (d[x] & bp->final[x]) return true;
+        }
+    }
+    for (int x = 0; x < w; x++) {
+        if (d[x] & bp->final[x]) return true;
+    }
+    return false;
+}
+
+bool bp_match(void *ctx, const char *line, size_t len){
+    return bp_accept(ctx, line, len);
+}
+
+/*Moteurs utilisables par main. Chaque thread crée son propre contexte par new_ctx :
+les contextes ne partagent que le programme, qui n’est jamais modifié pendant la
+recherche.*/
+
+struct engine {
+    const char *name;
+    void *(*new_ctx)(const program_t *p, bool unanchored);
+    void (*free_ctx)(void *ctx);
+    line_matcher_t match;
+    // motifs reconnus par le dernier appel à match ; NULL si un seul motif est géré
+    match_list_t *(*matches)(void *ctx);
+};
+
+void *backtrack_new_ctx(const program_t *p, bool unanchored){
+    return bitstate_new(p, unanchored);
+}
+
+void backtrack_free_ctx(void *ctx){
+    bitstate_free(ctx);
+}
+
+void *nfa_new_ctx(const program_t *p, bool unanchored){
+    struct nfa_matcher *m = malloc(sizeof(struct nfa_matcher));
+    m->p = p;
+    m->s1 = empty_set(p->n, 0);
+    m->s2 = empty_set(p->n, 1);
+    m->unanchored = unanchored;
+    m->ml = match_list_new(p->nb_patterns);
+    return m;
+}
+
+void nfa_free_ctx(void *ctx){
+    struct nfa_matcher *m = ctx;
+    set_free(m->s1);
+    set_free(m->s2);
+    match_list_free(m->ml);
+    free(m);
+}
+
+match_list_t *nfa_matches(void *ctx){
+    struct nfa_matcher *m = ctx;
+    return m->ml;
+}
+
+void *pike_new_ctx(const program_t *p, bool unanchored){
+    return pike_new(p, unanchored);
+}
+
+void pike_free_ctx(void *ctx){
+    pike_free(ctx);
+}
+
+void *dfa_new_ctx(const program_t *p, bool unanchored){
+    return lazy_dfa_new(p, DFA_MEMORY_BUDGET, unanchored);
+}
+
+void dfa_free_ctx(void *ctx){
+    lazy_dfa_free(ctx);
+}
+
+match_list_t *dfa_matches(void *ctx){
+    lazy_dfa_t *d = ctx;
+    return d->ml;
+}
+
+void *bp_new_ctx(const program_t *p, bool unanchored){
+    return bp_new(p, unanchored);
+}
+
+void bp_free_ctx(void *ctx){
+    bp_free(ctx);
+}
+
+const struct engine engines[] = {
+    {"backtrack", backtrack_new_ctx, backtrack_free_ctx, backtrack_match, NULL},
+    {"nfa", nfa_new_ctx, nfa_free_ctx, nfa_match, nfa_matches},
+    {"dfa", dfa_new_ctx, dfa_free_ctx, dfa_match, dfa_matches},
+    {"bitparallel", bp_new_ctx, bp_free_ctx, bp_match, NULL},
+    {"pike", pike_new_ctx, pike_free_ctx, pike_match, NULL},
+};
+
+#define NB_ENGINES ((int)(sizeof(engines) / sizeof(engines[0])))
+
+const struct engine *find_engine(const char *name){
+    for (int i = 0; i < NB_ENGINES; i++) {
+        if (strcmp(name, engines[i].name) == 0) return &engines[i];
+    }
+    return NULL;
+}
+
+/*fonction choose_engine qui choisit le moteur « auto » d’après la taille de l’automate :
+le moteur bit-parallèle pour un petit automate, le DFA paresseux sinon. Avec -f (labelled),
+on prend toujours le DFA, car le moteur bit-parallèle ne sait pas indiquer quels motifs
+sont reconnus, même quand le fichier n’en contient qu’un.*/
+
+const struct engine *choose_engine(const program_t *p, bool labelled){
+    if (!labelled && p->nb_patterns == 1 && count_positions(p) <= BP_MAX_POSITIONS) {
+        return find_engine("bitparallel");
+    }
+    return find_engine("dfa");
+}
+
+/*Une recherche associe un moteur, un programme, le mode (ancré ou non) et les littéraux
+servant de préfiltre (NULL pour ne pas filtrer). Le préfiltre rejette sans lancer le
+moteur les lignes qui ne contiennent pas req ; en mode ancré, il vérifie aussi prefix et
+suffix aux extrémités de la ligne, et en mode non ancré il fait démarrer le moteur à la
+première occurrence de prefix, puisque toute occurrence du motif commence par prefix.*/
+
+struct search {
+    const struct engine *e;
+    const program_t *p;
+    const literals_t *lit;
+    bool unanchored;
+    line_emit_t emit;
+};
+
+struct matcher {
+    const struct search *search;
+    void *ctx;
+    size_t req_len;
+    size_t prefix_len;
+    size_t suffix_len;
+};
+
+struct matcher *matcher_new(const struct search *search){
+    struct matcher *m = malloc(sizeof(struct matcher));
+    m->search = search;
+    m->ctx = search->e->new_ctx(search->p, search->unanchored);
+    m->req_len = search->lit == NULL ? 0 : strlen(search->lit->req);
+    m->prefix_len = search->lit == NULL ? 0 : strlen(search->lit->prefix);
+    m->suffix_len = search->lit == NULL ? 0 : strlen(search->lit->suffix);
+    return m;
+}
+
+void matcher_free(struct matcher *m){
+    m->search->e->free_ctx(m->ctx);
+    free(m);
+}
+
+bool matcher_match(void *ctx, const char *line, size_t len){
+    struct matcher *m = ctx;
+    const literals_t *lit = m->search->lit;
+    if (lit == NULL) return m->search->e->match(m->ctx, line, len);
+    if (m->req_len > 0 && find_literal(line, len, lit->req, m->req_len) == NULL) return false;
+    if (m->search->unanchored) {
+        if (m->prefix_len > 0) {
+            const char *start = find_literal(line, len, lit->prefix, m->prefix_len);
+            if (start == NULL) return false;
+            len -= start - line;
+            line = start;
+        }
+    } else {
+        if (len < m->prefix_len || memcmp(line, lit->prefix, m->prefix_len) != 0) return false;
+        if (len < m->suffix_len ||
+            memcmp(line + len - m->suffix_len, lit->suffix, m->suffix_len) != 0) return false;
+    }
+    return m->search->e->match(m->ctx, line, len);
+}
+
+/*fonction matcher_emit_labels qui écrit « k1,k2,...: » devant une ligne reconnue, les ki
+étant les numéros (à partir de 0) des motifs reconnus, dans l’ordre croissant*/
+
+void matcher_emit_labels(void *ctx, const char *line, size_t len, FILE *out){
+    struct matcher *m = ctx;
+    // avec un seul motif, les moteurs ne remplissent pas la liste
+    if (m->search->p->nb_patterns == 1) {
+        fputs("0:", out);
+    } else {
+        match_list_t *ml = m->search->e->matches(m->ctx);
+        qsort(ml->ids, ml->length, sizeof(int), compare_ints);
+        for (int i = 0; i < ml->length; i++) {
+            fprintf(out, i == 0 ? "%d" : ",%d", ml->ids[i]);
+        }
+        putc(':', out);
+    }
+    fwrite(line, 1, len, out);
+    putc('\n', out);
+}
+
+void matcher_emit_only(void *ctx, const char *line, size_t len, FILE *out){
+    struct matcher *m = ctx;
+    pike_emit_only(m->ctx, line, len, out);
+}
+
+/*Recherche parallèle dans un fichier projeté en mémoire. Le fichier est découpé en blocs
+d’environ CHUNK_SIZE octets, alignés sur les fins de ligne ; les threads prennent les
+blocs dans l’ordre et écrivent leurs lignes reconnues dans un tampon mémoire
+(open_memstream), que le thread principal recopie sur la sortie dans l’ordre des blocs.
+Pour borner la mémoire, un bloc n’est distribué que s’il est à moins de window blocs du
+prochain bloc à écrire.*/
+
+struct chunk_result {
+    char *data;
+    size_t size;
+    bool ready;
+};
+
+struct parallel_grep {
+    const struct search *search;
+    const char *buf;
+    size_t size;
+    size_t nb_chunks;
+    size_t next_chunk;
+    size_t next_output;
+    size_t window;
+    struct chunk_result *results;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t room;
+};
+
+/*fonction chunk_start qui renvoie le début du bloc i : le premier début de ligne à partir
+de la position i * CHUNK_SIZE*/
+
+size_t chunk_start(const char *buf, size_t size, size_t i){
+    if (i == 0) return 0;
+    size_t pos = i * CHUNK_SIZE;
+    if (pos >= size) return size;
+    const char *eol = memchr(buf + pos - 1, '\n', size - pos + 1);
+    return eol == NULL ? size : (size_t)(eol - buf) + 1;
+}
+
+void *grep_worker(void *arg){
+    struct parallel_grep *g = arg;
+    struct matcher *m = matcher_new(g->search);
+    pthread_mutex_lock(&g->lock);
+    while (g->next_chunk < g->nb_chunks) {
+        size_t i = g->next_chunk;
+        if (i >= g->next_output + g->window) {
+            pthread_cond_wait(&g->room, &g->lock);
+            continue;
+        }
+        g->next_chunk++;
+        pthread_mutex_unlock(&g->lock);
+        size_t start = chunk_start(g->buf, g->size, i);
+        size_t end = chunk_start(g->buf, g->size, i + 1);
+        char *data = NULL;
+        size_t size = 0;
+        FILE *out = open_memstream(&data, &size);
+        scan_lines(g->buf + start, end - start, true, matcher_match, g->search->emit, m, out);
+        fclose(out);
+        pthread_mutex_lock(&g->lock);
+        g->results[i].data = data;
+        g->results[i].size = size;
+        g->results[i].ready = true;
+        pthread_cond_signal(&g->ready);
+    }
+    pthread_mutex_unlock(&g->lock);
+    matcher_free(m);
+    return NULL;
+}
+
+/*fonction parallel_match renvoyant false (sans rien faire) si l’entrée n’est pas un
+fichier ordinaire projetable en mémoire*/
+
+bool parallel_match(const struct search *search, FILE *in, int nb_threads){
+    struct stat st;
+    int fd = fileno(in);
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) return false;
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) return false;
+    struct parallel_grep g;
+    g.search = search;
+    g.buf = map;
+    g.size = st.st_size;
+    g.nb_chunks = (g.size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    g.next_chunk = 0;
+    g.next_output = 0;
+    g.window = 4 * nb_threads;
+    g.results = calloc(g.nb_chunks, sizeof(struct chunk_result));
+    pthread_mutex_init(&g.lock, NULL);
+    pthread_cond_init(&g.ready, NULL);
+    pthread_cond_init(&g.room, NULL);
+    pthread_t *threads = malloc(nb_threads * sizeof(pthread_t));
+    for (int i = 0; i < nb_threads; i++) {
+        pthread_create(&threads[i], NULL, grep_worker, &g);
+    }
+    pthread_mutex_lock(&g.lock);
+    while (g.next_output < g.nb_chunks) {
+        struct chunk_result *r = &g.results[g.next_output];
+        if (!r->ready) {
+            pthread_cond_wait(&g.ready, &g.lock);
+            continue;
+        }
+        pthread_mutex_unlock(&g.lock);
+        fwrite(r->data, 1, r->size, stdout);
+        free(r->data);
+        pthread_mutex_lock(&g.lock);
+        g.next_output++;
+        pthread_cond_broadcast(&g.room);
+    }
+    pthread_mutex_unlock(&g.lock);
+    for (int i = 0; i < nb_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    fflush(stdout);
+    free(threads);
+    free(g.results);
+    pthread_mutex_destroy(&g.lock);
+    pthread_cond_destroy(&g.ready);
+    pthread_cond_destroy(&g.room);
+    munmap(map, st.st_size);
+    return true;
+}
+
+/*fonction read_patterns qui lit un motif (expression postfixe) par ligne non vide du
+fichier path ; renvoie NULL si le fichier ne peut pas être lu*/
+
+char **read_patterns(const char *path, int *nb){
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return NULL;
+    int capacity = 16;
+    char **patterns = malloc(capacity * sizeof(char*));
+    *nb = 0;
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    while ((len = getline(&line, &size, f)) != -1) {
+        if (len > 0 && line[len - 1] == '\n') line[--len] = '\0';
+        if (len == 0) continue;
+        if (*nb == capacity) {
+            capacity *= 2;
+            patterns = realloc(patterns, capacity * sizeof(char*));
+        }
+        patterns[(*nb)++] = strdup(line);
+    }
+    free(line);
+    fclose(f);
+    return patterns;
+}
+
+void usage(const char *name){
+    fprintf(stderr, "usage : %s [-u] [-m moteur] [-j threads] regex [fichier]\n", name);
+    fprintf(stderr, "        %s [-u] [-m moteur] [-j threads] -f motifs [fichier]\n", name);
+    fprintf(stderr, "  -u : recherche non ancrée (un facteur de la ligne suffit)\n");
+    fprintf(stderr, "  -o : n’écrit que les occurrences, suivies des groupes \\# (moteur pike)\n");
+    fprintf(stderr, "  -C cache : relit l’automate compilé depuis le fichier cache, ou l’y écrit\n");
+    fprintf(stderr, "  -f : un motif par ligne, les lignes reconnues sont précédées des numéros"
+                    " des motifs (à partir de 0)\nmoteurs : auto");
+    for (int i = 0; i < NB_ENGINES; i++) fprintf(stderr, " %s", engines[i].name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char* argv[]){
+    const char *mode = "auto";
+    const char *patterns_file = NULL;
+    const char *cache_file = NULL;
+    int nb_threads = 1;
+    bool unanchored = false;
+    bool only_matching = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:j:uof:C:")) != -1) {
+        switch (opt) {
+        case 'C':
+            cache_file = optarg;
+            break;
+        case 'o':
+            only_matching = true;
+            break;
+        case 'u':
+            unanchored = true;
+            break;
+        case 'f':
+            patterns_file = optarg;
+            break;
+        case 'm':
+            mode = optarg;
+            break;
+        case 'j':
+            nb_threads = atoi(optarg);
+            if (nb_threads <= 0) nb_threads = sysconf(_SC_NPROCESSORS_ONLN);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    int nb_patterns = 1;
+    char **patterns = NULL;
+    if (patterns_file != NULL) {
+        patterns = read_patterns(patterns_file, &nb_patterns);
+        if (patterns == NULL) {
+            perror(patterns_file);
+            return 1;
+        }
+        if (nb_patterns == 0) {
+            fprintf(stderr, "%s : aucun motif\n", patterns_file);
+            return 1;
+        }
+    } else {
+        if (optind >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        patterns = &argv[optind++];
+    }
+    FILE* in_f = stdin;
+    if (argc > optind) {
+        in_f = fopen(argv[optind],"r");
+        if (in_f == NULL) {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+    setvbuf(stdout, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+    // la clé d’un ensemble de motifs se termine par '\n', pas celle d’une expression seule
+    char *key = patterns[0];
+    if (patterns_file != NULL) {
+        size_t key_length = 0;
+        for (int k = 0; k < nb_patterns; k++) key_length += strlen(patterns[k]) + 1;
+        key = malloc(key_length + 1);
+        key[0] = '\0';
+        for (int k = 0; k < nb_patterns; k++) {
+            strcat(key, patterns[k]);
+            strcat(key, "\n");
+        }
+    }
+    program_t *p = cache_file == NULL ? NULL : program_map(cache_file, key);
+    if (p == NULL) {
+        p = patterns_file == NULL ? compile_regex(patterns[0])
+                                  : compile_patterns(patterns, nb_patterns);
+        if (cache_file != NULL && program_write(p, key, cache_file) != 0) perror(cache_file);
+    }
+    if (key != patterns[0]) free(key);
+    const struct engine *e = strcmp(mode, "auto") == 0 ? choose_engine(p, patterns_file != NULL)
+                                                   : find_engine(mode);
+    if (only_matching && strcmp(mode, "auto") == 0) e = find_engine("pike");
+    if (e == NULL) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (e == find_engine("bitparallel") && count_positions(p) > BP_MAX_POSITIONS) {
+        fprintf(stderr, "bitparallel : plus de %d positions\n", BP_MAX_POSITIONS);
+        return 1;
+    }
+    if (patterns_file != NULL && e->matches == NULL) {
+        fprintf(stderr, "%s : un seul motif à la fois\n", e->name);
+        return 1;
+    }
+    if (only_matching && (e != find_engine("pike") || patterns_file != NULL)) {
+        fprintf(stderr, "-o : seulement avec le moteur pike et un seul motif\n");
+        return 1;
+    }
+    // les littéraux obligatoires d’un motif ne le sont plus pour l’ensemble des motifs
+    literals_t *lit = patterns_file == NULL ? extract_literals(patterns[0]) : NULL;
+    struct search search = {e, p, lit, unanchored,
+                            patterns_file != NULL ? matcher_emit_labels
+                            : only_matching ? matcher_emit_only : NULL};
+    if (nb_threads == 1 || !parallel_match(&search, in_f, nb_threads)) {
+        struct matcher *m = matcher_new(&search);
+        match_lines(in_f, matcher_match, search.emit, m);
+        matcher_free(m);
+    }
+    if (lit != NULL) literals_free(lit);
+    if (patterns_file != NULL) {
+        for (int k = 0; k < nb_patterns; k++) free(patterns[k]);
+        free(patterns);
+    }
+    program_free(p);
+    if (in_f != stdin) fclose(in_f);
+    return 0;
 }
@@ -0,0 +1,52 @@
+#!/bin/sh
+# Tests de non-régression de arbre_couvrant_minimal.c. Le fichier ne contient pas les
+# parties du TP qu’il utilise (partition, read_graph) : on passe donc en argument le
+# programme déjà compilé (par défaut ./arbre_couvrant_minimal).
+set -e
+prog=${1:-./arbre_couvrant_minimal}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+# patch fichier position valeur : écrit l’entier 32 bits valeur (petit-boutiste)
+patch() {
+    printf "$(printf '\\%03o\\%03o\\%03o\\%03o' $(($3 & 255)) $(($3 >> 8 & 255)) \
+        $(($3 >> 16 & 255)) $(($3 >> 24 & 255)))" |
+        dd of="$1" bs=1 seek="$2" conv=notrunc 2>/dev/null
+}
+
+# rejected fichier : le programme doit refuser le fichier, sans planter
+rejected() {
+    if "$prog" -f "$1" > /dev/null 2> "$dir/err"; then
+        echo "$1 accepté"
+        exit 1
+    fi
+    grep -q "fichier de graphe invalide" "$dir/err"
+}
+
+# Graphe 0 - 1 - 2 : offsets (0, 1, 3, 4) à partir de l’octet 24, puis targets
+# (1, 0, 2, 1) à partir de l’octet 40.
+printf '3 2\n0 1 1.0\n1 2 2.0\n' > "$dir/g.txt"
+"$prog" -c "$dir/g.bin" < "$dir/g.txt"
+"$prog" < "$dir/g.txt" > "$dir/expected"
+"$prog" -f "$dir/g.bin" > "$dir/out"
+cmp "$dir/expected" "$dir/out"
+
+cp "$dir/g.bin" "$dir/asym.bin"
+patch "$dir/asym.bin" 44 2
+rejected "$dir/asym.bin"
+
+cp "$dir/g.bin" "$dir/loop.bin"
+patch "$dir/loop.bin" 44 1
+rejected "$dir/loop.bin"
+
+cp "$dir/g.bin" "$dir/offsets.bin"
+patch "$dir/offsets.bin" 28 4
+rejected "$dir/offsets.bin"
+
+cp "$dir/g.bin" "$dir/range.bin"
+patch "$dir/range.bin" 52 3
+rejected "$dir/range.bin"
+
+head -c 48 "$dir/g.bin" > "$dir/truncated.bin"
+rejected "$dir/truncated.bin"
+echo "ok"
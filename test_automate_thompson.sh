@@ -0,0 +1,43 @@
+#!/bin/sh
+# Tests de non-régression de automate_thompson.c.
+set -e
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cc -O2 -o "$dir/thompson" "$(dirname "$0")/automate_thompson.c" -lpthread
+
+# Le moteur « auto » accepte -f avec un fichier ne contenant qu’un motif, et donne alors
+# le même résultat que le moteur dfa.
+printf 'ab@\n' > "$dir/one.pat"
+printf 'ab\nxx\nab\n' > "$dir/in.txt"
+printf '0:ab\n0:ab\n' > "$dir/expected"
+"$dir/thompson" -f "$dir/one.pat" "$dir/in.txt" > "$dir/auto"
+"$dir/thompson" -m dfa -f "$dir/one.pat" "$dir/in.txt" > "$dir/dfa"
+cmp "$dir/expected" "$dir/auto"
+cmp "$dir/expected" "$dir/dfa"
+
+# Avec plusieurs motifs étiquetés, « auto » choisit le dfa et tous les moteurs qui
+# connaissent les étiquettes donnent les mêmes lignes, avec les mêmes étiquettes.
+printf 'ab@\na.@\nb*\n' > "$dir/many.pat"
+printf 'ab\nac\nbbb\n\nzz\n' > "$dir/in.txt"
+printf '0,1:ab\n1:ac\n2:bbb\n2:\n' > "$dir/expected"
+for engine in auto nfa dfa; do
+    "$dir/thompson" -m $engine -f "$dir/many.pat" "$dir/in.txt" > "$dir/out"
+    cmp "$dir/expected" "$dir/out"
+done
+printf '0,1,2:ab\n1,2:ac\n2:bbb\n2:\n2:zz\n' > "$dir/expected"
+for engine in auto nfa dfa; do
+    "$dir/thompson" -u -m $engine -f "$dir/many.pat" "$dir/in.txt" > "$dir/out"
+    cmp "$dir/expected" "$dir/out"
+done
+
+# # est un caractère ordinaire pour tous les moteurs ; \# marque un groupe de capture.
+printf 'x#y\nxy\nx##y\n' > "$dir/in.txt"
+printf 'x#y\n' > "$dir/expected"
+for engine in auto backtrack nfa dfa bitparallel pike; do
+    "$dir/thompson" -m $engine 'x#@y@' "$dir/in.txt" > "$dir/out"
+    cmp "$dir/expected" "$dir/out"
+done
+printf 'x#y\t#\n' > "$dir/expected"
+"$dir/thompson" -o 'x#\#@y@' "$dir/in.txt" > "$dir/out"
+cmp "$dir/expected" "$dir/out"
+echo "ok"